@@ -4,6 +4,8 @@
 #include <windows.h>
 #include <iostream>
 #include <functional>
+#include <chrono>
+#include <unordered_map>
 #include "Application.hpp"
 #include "Console.hpp"
 #include "CompilerExceptions.hpp"
@@ -29,12 +31,21 @@ SampleRender::Application::Application(std::string programLocation) :
 		Eigen::Matrix4f::Identity()
 	};
 	m_Starter.reset(new ApplicationStarter("render.json"));
-	m_Window.reset(Window::Instantiate());
-	m_Context.reset(GraphicsContext::Instantiate(m_Window.get(), 3));
-	m_Window->ConnectResizer(std::bind(&GraphicsContext::WindowResize, m_Context.get(), std::placeholders::_1, std::placeholders::_2));
-	std::stringstream buffer;
-	buffer << "SampleRender Window [" << (m_Starter->GetCurrentAPI() == GraphicsAPI::SAMPLE_RENDER_GRAPHICS_API_VK ? "Vulkan" : "D3D12") << "]";
-	m_Window->ResetTitle(buffer.str());
+	m_ThreadPool.reset(new ThreadPool());
+	const HeadlessSettings& headless = m_Starter->GetHeadlessSettings();
+	if (headless.Enabled)
+	{
+		m_Context.reset(GraphicsContext::InstantiateHeadless(headless.Width, headless.Height, m_Starter->GetGraphicsSettings()));
+	}
+	else
+	{
+		m_Window.reset(Window::Instantiate());
+		m_Context.reset(GraphicsContext::Instantiate(m_Window.get(), m_Starter->GetGraphicsSettings()));
+		m_Window->ConnectResizer(std::bind(&GraphicsContext::WindowResize, m_Context.get(), std::placeholders::_1, std::placeholders::_2));
+		std::stringstream buffer;
+		buffer << "SampleRender Window [" << (m_Starter->GetCurrentAPI() == GraphicsAPI::SAMPLE_RENDER_GRAPHICS_API_VK ? "Vulkan" : "D3D12") << "]";
+		m_Window->ResetTitle(buffer.str());
+	}
 	try
 	{
 		m_SPVCompiler.reset(new SPVCompiler("_main", "_6_8", "1.3"));
@@ -49,6 +60,8 @@ SampleRender::Application::Application(std::string programLocation) :
 		Console::CoreError("{}", e.what());
 	}
 
+	m_Context->WarmUpPipelines(m_ThreadPool.get());
+
 	InputBufferLayout layout(
 	{
 		{ShaderDataType::Float3, "POSITION", false},
@@ -81,9 +94,9 @@ SampleRender::Application::Application(std::string programLocation) :
 		}
 	);
 
-	m_Shader.reset(Shader::Instantiate(&m_Context, "./assets/shaders/HelloTriangle", layout, smallBufferLayout, uniformLayout, textureLayout, samplerLayout));
+	m_Shader.reset(Shader::InstantiateAsync(&m_Context, "./assets/shaders/HelloTriangle", layout, smallBufferLayout, uniformLayout, textureLayout, samplerLayout));
 	m_VertexBuffer.reset(VertexBuffer::Instantiate(&m_Context,(const void*)vBuffer[0].data(), sizeof(vBuffer), layout.GetStride()));
-	m_IndexBuffer.reset(IndexBuffer::Instantiate(&m_Context, (const void*)&iBuffer[0], sizeof(iBuffer) / sizeof(uint32_t)));
+	m_IndexBuffer.reset(IndexBuffer::InstantiateNarrowest(&m_Context, &iBuffer[0], sizeof(iBuffer) / sizeof(uint32_t)));
 }
 
 SampleRender::Application::~Application()
@@ -91,31 +104,30 @@ SampleRender::Application::~Application()
 	m_IndexBuffer.reset();
 	m_VertexBuffer.reset();
 	m_Shader.reset();
+	m_ThreadPool.reset();
 	m_Context.reset();
 	m_Window.reset();
 }
 
 void SampleRender::Application::Run()
 {
+	if (!m_Window)
+	{
+		RunHeadless(m_Starter->GetHeadlessSettings().Frames);
+		return;
+	}
+
 	while (!m_Window->ShouldClose()) 
 	{
+		//input is sampled after pacing, as close to the frame start as possible
+		m_Context->PaceFrame();
 		for (Layer* layer : m_LayerStack)
 			layer->OnUpdate();
 		m_Window->Update();
 		if (!m_Window->IsMinimized())
 		{
 			try {
-				m_Context->ReceiveCommands();
-				m_Shader->Stage();
-				m_Shader->BindSmallBuffer(&m_SmallMVP.model(0, 0), sizeof(m_SmallMVP), 0);
-				m_Shader->BindUniforms(&m_CompleteMVP.model(0, 0), sizeof(m_CompleteMVP), 1);
-				m_Shader->BindTexture(2);
-				m_VertexBuffer->Stage();
-				m_IndexBuffer->Stage();
-				m_Context->StageViewportAndScissors();
-				m_Context->Draw(m_IndexBuffer->GetCount());
-				m_Context->DispatchCommands();
-				m_Context->Present();
+				RenderFrame();
 			}
 			catch (GraphicsException e)
 			{
@@ -126,6 +138,61 @@ void SampleRender::Application::Run()
 	}
 }
 
+void SampleRender::Application::RunHeadless(uint32_t frames)
+{
+	Console::CoreLog("Running {} headless frames on {}", frames, m_Context->GetGPUName());
+	std::unordered_map<std::string, std::pair<double, uint32_t>> gpuScopes;
+	auto start = std::chrono::high_resolution_clock::now();
+	try {
+		for (uint32_t i = 0; i < frames; i++)
+		{
+			for (Layer* layer : m_LayerStack)
+				layer->OnUpdate();
+			RenderFrame();
+			for (auto& scope : m_Context->GetGPUTimestamps())
+			{
+				auto& accumulated = gpuScopes[scope.Name];
+				accumulated.first += scope.Milliseconds;
+				accumulated.second++;
+			}
+		}
+	}
+	catch (GraphicsException e)
+	{
+		Console::CoreError("Caught error: {}", e.what());
+		exit(2);
+	}
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+	if (frames > 0)
+	{
+		double frameTime = elapsed.count() / frames;
+		Console::CoreLog("Average frame time: {:.3f} ms ({:.1f} fps)", frameTime, 1000.0 / frameTime);
+	}
+	for (auto& [name, accumulated] : gpuScopes)
+		Console::CoreLog("Average GPU time [{}]: {:.3f} ms", name, accumulated.first / accumulated.second);
+}
+
+void SampleRender::Application::RenderFrame()
+{
+	m_Context->ReceiveCommands();
+	//streamed resources are only drawn once their copies have landed
+	if (m_Shader->IsReady() && m_VertexBuffer->IsReady() && m_IndexBuffer->IsReady())
+	{
+		m_Context->BeginGPUTimestamp("HelloTriangle");
+		m_Shader->Stage();
+		m_Shader->BindSmallBuffer(&m_SmallMVP.model(0, 0), sizeof(m_SmallMVP), 0);
+		m_Shader->BindUniforms(&m_CompleteMVP.model(0, 0), sizeof(m_CompleteMVP), 1);
+		m_Shader->BindTexture(2);
+		m_VertexBuffer->Stage();
+		m_IndexBuffer->Stage();
+		m_Context->StageViewportAndScissors();
+		m_Context->Draw(m_IndexBuffer->GetCount());
+		m_Context->EndGPUTimestamp();
+	}
+	m_Context->DispatchCommands();
+	m_Context->Present();
+}
+
 void SampleRender::Application::EnableSingleton(Application* ptr)
 {
 	if (!s_SingletonEnabled)
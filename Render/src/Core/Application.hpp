@@ -14,6 +14,7 @@
 #include "Shader.hpp"
 #include "Buffer.hpp"
 #include "ApplicationStarter.hpp"
+#include "ThreadPool.hpp"
 #include <Eigen/Eigen>
 
 namespace SampleRender
@@ -25,6 +26,7 @@ namespace SampleRender
 		~Application();
 
 		void Run();
+		void RunHeadless(uint32_t frames);
 	
 		GraphicsAPI GetCurrentAPI()
 		{
@@ -32,11 +34,13 @@ namespace SampleRender
 		}
 		
 		inline const std::string& GetProgramPath() { return m_ProgramLocation; }
+		inline ThreadPool* GetThreadPool() { return m_ThreadPool.get(); }
 
 		static void EnableSingleton(Application* ptr);
 		static Application* GetInstance();
 
 	private:
+		void RenderFrame();
 
 		Eigen::Vector<float, 9> vBuffer[4] =
 		{
@@ -73,6 +77,8 @@ namespace SampleRender
 		std::shared_ptr<Window> m_Window;
 		std::shared_ptr<GraphicsContext> m_Context;
 		std::shared_ptr<Shader> m_Shader;
+		//Asset loading, shaders build their pipelines here
+		std::shared_ptr<ThreadPool> m_ThreadPool;
 
 		std::shared_ptr<VertexBuffer> m_VertexBuffer;
 		std::shared_ptr<IndexBuffer> m_IndexBuffer;
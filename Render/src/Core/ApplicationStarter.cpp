@@ -1,5 +1,7 @@
 #include "ApplicationStarter.hpp"
 #include "FileHandler.hpp"
+#include "Console.hpp"
+#include <algorithm>
 
 const std::unordered_map<std::string, SampleRender::GraphicsAPI> SampleRender::ApplicationStarter::s_GraphicsAPIMapper =
 {
@@ -9,6 +11,14 @@ const std::unordered_map<std::string, SampleRender::GraphicsAPI> SampleRender::A
 #endif
 };
 
+const std::unordered_map<std::string, SampleRender::PresentMode> SampleRender::ApplicationStarter::s_PresentModeMapper =
+{
+	{"FIFO", SampleRender::PresentMode::FIFO},
+	{"FIFO_RELAXED", SampleRender::PresentMode::FIFO_RELAXED},
+	{"MAILBOX", SampleRender::PresentMode::MAILBOX},
+	{"IMMEDIATE", SampleRender::PresentMode::IMMEDIATE},
+};
+
 SampleRender::ApplicationStarter::ApplicationStarter(std::string_view jsonFilepath)
 {
 	if(!FileHandler::FileExists(jsonFilepath.data()))
@@ -36,6 +46,8 @@ SampleRender::ApplicationStarter::ApplicationStarter(std::string_view jsonFilepa
 			m_API = it->second;
 		}
 
+		ReadHeadlessSettings();
+		ReadGraphicsSettings();
 	}
 }
 
@@ -47,3 +59,58 @@ SampleRender::GraphicsAPI SampleRender::ApplicationStarter::GetCurrentAPI()
 {
 	return m_API;
 }
+
+const SampleRender::HeadlessSettings& SampleRender::ApplicationStarter::GetHeadlessSettings() const
+{
+	return m_Headless;
+}
+
+const SampleRender::GraphicsSettings& SampleRender::ApplicationStarter::GetGraphicsSettings() const
+{
+	return m_Graphics;
+}
+
+void SampleRender::ApplicationStarter::ReadGraphicsSettings()
+{
+	const Json::Value& graphics = m_Starter["Graphics"];
+	if (!graphics.isObject())
+		return;
+
+	m_Graphics.FramesInFlight = std::max(graphics.get("FramesInFlight", m_Graphics.FramesInFlight).asUInt(), 1u);
+	m_Graphics.SwapChainImages = graphics.get("SwapChainImages", m_Graphics.SwapChainImages).asUInt();
+	m_Graphics.LowLatency = graphics.get("LowLatency", m_Graphics.LowLatency).asBool();
+	m_Graphics.PipelineCachePath = graphics.get("PipelineCachePath", m_Graphics.PipelineCachePath).asString();
+	m_Graphics.PipelineManifestPath = graphics.get("PipelineManifestPath", m_Graphics.PipelineManifestPath).asString();
+	m_Graphics.RecordPipelineManifest = graphics.get("RecordPipelineManifest", m_Graphics.RecordPipelineManifest).asBool();
+	m_Graphics.ShaderObjects = graphics.get("ShaderObjects", m_Graphics.ShaderObjects).asBool();
+	m_Graphics.DynamicRendering = graphics.get("DynamicRendering", m_Graphics.DynamicRendering).asBool();
+	m_Graphics.DefragmentationBudget = graphics.get("DefragmentationBudget", m_Graphics.DefragmentationBudget).asUInt();
+	m_Graphics.BindlessTextures = graphics.get("BindlessTextures", m_Graphics.BindlessTextures).asBool();
+
+	if (graphics.isMember("PresentMode"))
+	{
+		auto it = s_PresentModeMapper.find(graphics["PresentMode"].asString());
+		if (it == s_PresentModeMapper.end())
+			Console::CoreWarn("Unknown present mode {}, using FIFO", graphics["PresentMode"].asString());
+		else
+			m_Graphics.Present = it->second;
+	}
+}
+
+void SampleRender::ApplicationStarter::ReadHeadlessSettings()
+{
+	const Json::Value& headless = m_Starter["Headless"];
+	if (!headless.isObject())
+		return;
+
+	m_Headless.Enabled = headless.get("Enabled", m_Headless.Enabled).asBool();
+	m_Headless.Width = headless.get("Width", m_Headless.Width).asUInt();
+	m_Headless.Height = headless.get("Height", m_Headless.Height).asUInt();
+	m_Headless.Frames = headless.get("Frames", m_Headless.Frames).asUInt();
+
+	if (m_Headless.Enabled && (m_API != SAMPLE_RENDER_GRAPHICS_API_VK))
+	{
+		Console::CoreWarn("Headless mode is only available on Vulkan, switching API");
+		m_API = SAMPLE_RENDER_GRAPHICS_API_VK;
+	}
+}
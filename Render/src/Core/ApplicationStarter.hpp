@@ -6,6 +6,14 @@
 
 namespace SampleRender
 {
+	struct HeadlessSettings
+	{
+		bool Enabled = false;
+		uint32_t Width = 1280;
+		uint32_t Height = 720;
+		uint32_t Frames = 1000;
+	};
+
 	class SAMPLE_RENDER_DLL_COMMAND ApplicationStarter
 	{
 	public:
@@ -13,10 +21,18 @@ namespace SampleRender
 		~ApplicationStarter();
 
 		GraphicsAPI GetCurrentAPI();
+		const HeadlessSettings& GetHeadlessSettings() const;
+		const GraphicsSettings& GetGraphicsSettings() const;
 	private:
+		void ReadHeadlessSettings();
+		void ReadGraphicsSettings();
+
 		Json::Value m_Starter;
 		GraphicsAPI m_API;
+		HeadlessSettings m_Headless;
+		GraphicsSettings m_Graphics;
 
 		static const std::unordered_map<std::string, GraphicsAPI> s_GraphicsAPIMapper;
+		static const std::unordered_map<std::string, PresentMode> s_PresentModeMapper;
 	};
 }
@@ -4,6 +4,18 @@
 #include "D3D12Buffer.hpp"
 #endif
 #include "VKBuffer.hpp"
+#include <algorithm>
+#include <vector>
+
+uint32_t SampleRender::IndexFormatSize(IndexFormat format)
+{
+	switch (format)
+	{
+	case IndexFormat::Uint16: return sizeof(uint16_t);
+	case IndexFormat::Uint32: return sizeof(uint32_t);
+	}
+	return 0;
+}
 
 SampleRender::VertexBuffer* SampleRender::VertexBuffer::Instantiate(const std::shared_ptr<GraphicsContext>* context, const void* data, size_t size, uint32_t stride)
 {
@@ -26,7 +38,39 @@ SampleRender::VertexBuffer* SampleRender::VertexBuffer::Instantiate(const std::s
 	return nullptr;
 }
 
-SampleRender::IndexBuffer* SampleRender::IndexBuffer::Instantiate(const std::shared_ptr<GraphicsContext>* context, const void* data, size_t count)
+SampleRender::IndexBuffer* SampleRender::IndexBuffer::Instantiate(const std::shared_ptr<GraphicsContext>* context, const void* data, size_t count, IndexFormat format)
+{
+	GraphicsAPI api = Application::GetInstance()->GetCurrentAPI();
+	switch (api)
+	{
+#ifdef RENDER_USES_WINDOWS
+	case SampleRender::SAMPLE_RENDER_GRAPHICS_API_D3D12:
+	{
+		return new D3D12IndexBuffer((const std::shared_ptr<D3D12Context>*)(context), data, count, format);
+	}
+#endif
+	case SampleRender::SAMPLE_RENDER_GRAPHICS_API_VK:
+	{
+		return new VKIndexBuffer((const std::shared_ptr<VKContext>*)(context), data, count, format);
+	}
+	default:
+		break;
+	}
+	return nullptr;
+}
+
+SampleRender::IndexBuffer* SampleRender::IndexBuffer::InstantiateNarrowest(const std::shared_ptr<GraphicsContext>* context, const uint32_t* indices, size_t count)
+{
+	//0xffff is kept out, it is the strip restart value for 16 bit indices
+	uint32_t maxIndex = (count > 0) ? *std::max_element(indices, indices + count) : 0;
+	if (maxIndex >= 0xffff)
+		return Instantiate(context, indices, count, IndexFormat::Uint32);
+
+	std::vector<uint16_t> narrowIndices(indices, indices + count);
+	return Instantiate(context, narrowIndices.data(), count, IndexFormat::Uint16);
+}
+
+SampleRender::IndirectBuffer* SampleRender::IndirectBuffer::Instantiate(const std::shared_ptr<GraphicsContext>* context, const void* data, size_t size)
 {
 	GraphicsAPI api = Application::GetInstance()->GetCurrentAPI();
 	switch (api)
@@ -34,12 +78,12 @@ SampleRender::IndexBuffer* SampleRender::IndexBuffer::Instantiate(const std::sha
 #ifdef RENDER_USES_WINDOWS
 	case SampleRender::SAMPLE_RENDER_GRAPHICS_API_D3D12:
 	{
-		return new D3D12IndexBuffer((const std::shared_ptr<D3D12Context>*)(context), data, count);
+		return new D3D12IndirectBuffer((const std::shared_ptr<D3D12Context>*)(context), data, size);
 	}
 #endif
 	case SampleRender::SAMPLE_RENDER_GRAPHICS_API_VK:
 	{
-		return new VKIndexBuffer((const std::shared_ptr<VKContext>*)(context), data, count);
+		return new VKIndirectBuffer((const std::shared_ptr<VKContext>*)(context), data, size);
 	}
 	default:
 		break;
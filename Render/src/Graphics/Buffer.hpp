@@ -7,12 +7,22 @@
 
 namespace SampleRender
 {
+	enum class IndexFormat
+	{
+		Uint16, Uint32
+	};
+
+	SAMPLE_RENDER_DLL_COMMAND uint32_t IndexFormatSize(IndexFormat format);
+
 	class SAMPLE_RENDER_DLL_COMMAND VertexBuffer
 	{
 	public:
 		virtual ~VertexBuffer() = default;
 
-		virtual void Stage() const = 0;
+		//bindingSlot matches the buffer slot of the layout elements it feeds
+		virtual void Stage(uint32_t bindingSlot = 0) const = 0;
+		//False while the data is still streaming in, the buffer must not be staged until then
+		virtual bool IsReady() const = 0;
 		static VertexBuffer* Instantiate(const std::shared_ptr<GraphicsContext>* context, const void* data, size_t size, uint32_t stride);
 	};
 
@@ -23,10 +33,37 @@ namespace SampleRender
 
 		virtual void Stage() const = 0;
 		virtual uint32_t GetCount() const = 0;
+		virtual IndexFormat GetFormat() const = 0;
+		virtual bool IsReady() const = 0;
 
-		static IndexBuffer* Instantiate(const std::shared_ptr<GraphicsContext>* context, const void* data, size_t count);
+		//data holds count indices of the given format
+		static IndexBuffer* Instantiate(const std::shared_ptr<GraphicsContext>* context, const void* data, size_t count, IndexFormat format = IndexFormat::Uint32);
+		//Stores the indices as 16 bit whenever the largest one fits
+		static IndexBuffer* InstantiateNarrowest(const std::shared_ptr<GraphicsContext>* context, const uint32_t* indices, size_t count);
 
 	protected:
 		uint32_t m_Count;
+		IndexFormat m_Format;
+	};
+
+	//Same layout as VkDrawIndexedIndirectCommand and D3D12_DRAW_INDEXED_ARGUMENTS
+	struct IndirectDrawArguments
+	{
+		uint32_t IndexCount;
+		uint32_t InstanceCount;
+		uint32_t FirstIndex;
+		int32_t BaseVertex;
+		uint32_t FirstInstance;
+	};
+
+	//Holds IndirectDrawArguments or draw counts, may also be written by the GPU
+	class SAMPLE_RENDER_DLL_COMMAND IndirectBuffer
+	{
+	public:
+		virtual ~IndirectBuffer() = default;
+
+		virtual bool IsReady() const = 0;
+
+		static IndirectBuffer* Instantiate(const std::shared_ptr<GraphicsContext>* context, const void* data, size_t size);
 	};
 }
@@ -5,17 +5,30 @@
 #endif
 #include "VKContext.hpp"
 
-SampleRender::GraphicsContext* SampleRender::GraphicsContext::Instantiate(const Window* window, uint32_t framesInFlight)
+SampleRender::GraphicsContext* SampleRender::GraphicsContext::Instantiate(const Window* window, const GraphicsSettings& settings)
 {
 	GraphicsAPI api = Application::GetInstance()->GetCurrentAPI();
 	switch (api)
 	{
 #ifdef RENDER_USES_WINDOWS
 	case SampleRender::SAMPLE_RENDER_GRAPHICS_API_D3D12:
-		return new D3D12Context(window, framesInFlight);
+		return new D3D12Context(window, settings);
 #endif
 	case SampleRender::SAMPLE_RENDER_GRAPHICS_API_VK:
-		return new VKContext(window, framesInFlight);
+		return new VKContext(window, settings);
+	default:
+		break;
+	}
+	return nullptr;
+}
+
+SampleRender::GraphicsContext* SampleRender::GraphicsContext::InstantiateHeadless(uint32_t width, uint32_t height, const GraphicsSettings& settings)
+{
+	GraphicsAPI api = Application::GetInstance()->GetCurrentAPI();
+	switch (api)
+	{
+	case SampleRender::SAMPLE_RENDER_GRAPHICS_API_VK:
+		return new VKContext(width, height, settings);
 	default:
 		break;
 	}
@@ -3,14 +3,19 @@
 #include <any>
 #include <cstdint>
 #include <string>
+#include <string_view>
+#include <vector>
 #include "RenderDLLMacro.hpp"
 #include "Window.hpp"
 #include "CommonException.hpp"
+#include "ThreadPool.hpp"
 
 #include <exception>
 
 namespace SampleRender
 {
+	class IndirectBuffer;
+	enum class IndexFormat;
 	
 	enum GraphicsAPI
 	{
@@ -20,6 +25,57 @@ namespace SampleRender
 #endif //D3D12_GUARD
 	};
 
+	enum class PresentMode
+	{
+		FIFO,
+		FIFO_RELAXED,
+		MAILBOX,
+		IMMEDIATE
+	};
+
+	struct GraphicsSettings
+	{
+		uint32_t FramesInFlight = 3;
+		//Vulkan only, 0 lets the backend pick the driver minimum plus one, D3D12 keeps one back buffer per frame in flight
+		uint32_t SwapChainImages = 0;
+		PresentMode Present = PresentMode::FIFO;
+		//Waits for the last present to reach the display before the next frame starts
+		bool LowLatency = false;
+		//Compiled pipelines are kept here between runs, empty disables persistence
+		std::string PipelineCachePath = "pipeline.cache";
+		//Pipelines listed here are precompiled in the background at startup, empty disables warm-up
+		std::string PipelineManifestPath = "pipelines.json";
+		//Writes every pipeline built during the session back to the manifest
+		bool RecordPipelineManifest = false;
+		//Vulkan only, replaces the baked pipelines with VK_EXT_shader_object and fully dynamic state, falls back to pipelines when unsupported
+		bool ShaderObjects = false;
+		//Vulkan only, renders straight into the image views without render passes or framebuffers
+		bool DynamicRendering = false;
+		//Vulkan only, megabytes of resources moved per frame to empty sparse memory blocks, 0 disables defragmentation
+		uint32_t DefragmentationBudget = 4;
+		//Vulkan only, every texture and sampler also goes into one update-after-bind array, indexed from push constants
+		bool BindlessTextures = false;
+	};
+
+	struct GPUTimestampScope
+	{
+		std::string Name;
+		double Milliseconds;
+	};
+
+	struct GPUMemoryStatistics
+	{
+		//bytes bound to resources and bytes taken from the device
+		uint64_t AllocatedBytes = 0;
+		uint64_t ReservedBytes = 0;
+		uint64_t LargestFreeRange = 0;
+		uint32_t DeviceMemoryCount = 0;
+		//1 - LargestFreeRange / free bytes, 0 when the free space is contiguous
+		float Fragmentation = 0.0f;
+		//moved by defragmentation since startup
+		uint64_t RelocatedBytes = 0;
+	};
+
 	class SAMPLE_RENDER_DLL_COMMAND GraphicsContext
 	{
 	public:
@@ -30,17 +86,47 @@ namespace SampleRender
 		virtual uint32_t GetUniformAttachment() const = 0;
 		virtual uint32_t GetSmallBufferAttachment() const = 0;
 
+		//Called before input is sampled, blocks just long enough to start the frame in time
+		virtual void PaceFrame() = 0;
 		virtual void ReceiveCommands() = 0;
 		virtual void DispatchCommands() = 0;
 		virtual void Present() = 0;
 		virtual void StageViewportAndScissors() = 0;
 
 		virtual void Draw(uint32_t elements) = 0;
+		//firstIndex is counted in indices, baseVertex is added to every index read
+		virtual void DrawInstanced(uint32_t elements, uint32_t instances, uint32_t firstIndex = 0, int32_t baseVertex = 0, uint32_t firstInstance = 0) = 0;
+		//Reads drawCount consecutive IndirectDrawArguments, argumentOffset is in bytes
+		virtual void DrawIndexedIndirect(const IndirectBuffer* arguments, uint32_t drawCount, uint64_t argumentOffset = 0) = 0;
+		//The draw count is a uint32_t read from countBuffer on the GPU, clamped to maxDraws
+		virtual void DrawIndexedIndirectCount(const IndirectBuffer* arguments, const IndirectBuffer* countBuffer, uint32_t maxDraws, uint64_t argumentOffset = 0, uint64_t countOffset = 0) = 0;
+		//Copies into this frame's transient space and binds it, for geometry rewritten every frame, like particles or UI
+		virtual void StageDynamicVertices(const void* data, size_t size, uint32_t stride, uint32_t bindingSlot = 0) = 0;
+		virtual void StageDynamicIndices(const void* data, uint32_t count, IndexFormat format) = 0;
 
 		virtual const std::string GetGPUName() = 0;
 
 		virtual void WindowResize(uint32_t width, uint32_t height) = 0;
 
-		static GraphicsContext* Instantiate(const Window* window, uint32_t framesInFlight = 3);
+		//Must be called outside a frame, returns how many workers were enabled (0 means inline recording only)
+		//While workers are enabled every draw of the frame must be recorded inside a worker range
+		virtual uint32_t SetRecordingWorkers(uint32_t workers) = 0;
+		//Called from the recording thread, ranges of distinct workers may be recorded in parallel
+		virtual void BeginWorkerCommands(uint32_t worker) = 0;
+		virtual void EndWorkerCommands(uint32_t worker) = 0;
+
+		//Scopes may nest, they must be opened and closed between ReceiveCommands and DispatchCommands, on the same command range
+		virtual void BeginGPUTimestamp(std::string_view name) = 0;
+		virtual void EndGPUTimestamp() = 0;
+		//Results of the last frame whose slot has been released for reuse, never stalls
+		virtual const std::vector<GPUTimestampScope>& GetGPUTimestamps() const = 0;
+		virtual GPUMemoryStatistics GetMemoryStatistics() = 0;
+
+		//Compiles the recorded pipeline manifest on the pool, call before the shaders are requested
+		virtual void WarmUpPipelines(ThreadPool* pool) = 0;
+
+		static GraphicsContext* Instantiate(const Window* window, const GraphicsSettings& settings = GraphicsSettings());
+		//Vulkan only, renders into offscreen targets, no window or swapchain needed
+		static GraphicsContext* InstantiateHeadless(uint32_t width, uint32_t height, const GraphicsSettings& settings = GraphicsSettings());
 	};
 }
\ No newline at end of file
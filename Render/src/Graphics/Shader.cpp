@@ -40,3 +40,31 @@ SampleRender::Shader* SampleRender::Shader::Instantiate(const std::shared_ptr<Gr
 	}
 	return nullptr;
 }
+
+SampleRender::Shader* SampleRender::Shader::InstantiateAsync(const std::shared_ptr<GraphicsContext>* context, std::string json_basepath, InputBufferLayout layout, SmallBufferLayout smallBufferLayout, UniformLayout uniformLayout, TextureLayout textureLayout, SamplerLayout samplerLayout)
+{
+	GraphicsAPI api = Application::GetInstance()->GetCurrentAPI();
+	std::stringstream controller_path;
+	controller_path << json_basepath;
+	switch (api)
+	{
+#ifdef RENDER_USES_WINDOWS
+	case SampleRender::SAMPLE_RENDER_GRAPHICS_API_D3D12:
+	{
+		//D3D12 keeps building on the calling thread
+		controller_path << ".d3d12.json";
+		std::string json_controller_path = controller_path.str();
+		return new D3D12Shader((const std::shared_ptr<D3D12Context>*)(context), json_controller_path, layout, smallBufferLayout, uniformLayout, textureLayout, samplerLayout);
+	}
+#endif
+	case SampleRender::SAMPLE_RENDER_GRAPHICS_API_VK:
+	{
+		controller_path << ".vk.json";
+		std::string json_controller_path = controller_path.str();
+		return new VKShader((const std::shared_ptr<VKContext>*)(context), json_controller_path, layout, smallBufferLayout, uniformLayout, textureLayout, samplerLayout, Application::GetInstance()->GetThreadPool());
+	}
+	default:
+		break;
+	}
+	return nullptr;
+}
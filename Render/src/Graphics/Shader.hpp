@@ -23,11 +23,19 @@ namespace SampleRender
 		virtual void Stage() = 0;
 		virtual uint32_t GetStride() const = 0;
 		virtual uint32_t GetOffset() const = 0;
+		//False while the textures are still streaming in
+		virtual bool IsReady() const = 0;
 
 		virtual void BindSmallBuffer(const void* data, size_t size, uint32_t bindingSlot) = 0;
 		virtual void BindUniforms(const void* data, size_t size, uint32_t shaderRegister) = 0;
 		virtual void BindTexture(uint32_t shaderRegister) = 0;
+		//Slots in the bindless texture and sampler arrays, pushed through the small buffer to select a material without rebinding
+		//Backends without a bindless mode return the shader register, UINT32_MAX until IsReady
+		virtual uint32_t GetTextureIndex(uint32_t shaderRegister) const = 0;
+		virtual uint32_t GetSamplerIndex(uint32_t shaderRegister) const = 0;
 
 		static Shader* Instantiate(const std::shared_ptr<GraphicsContext>* context, std::string json_basepath, InputBufferLayout layout, SmallBufferLayout smallBufferLayout, UniformLayout uniformLayout, TextureLayout textureLayout, SamplerLayout samplerLayout);
+		//Returns right away and builds on the application worker pool where the backend allows it, poll IsReady before drawing
+		static Shader* InstantiateAsync(const std::shared_ptr<GraphicsContext>* context, std::string json_basepath, InputBufferLayout layout, SmallBufferLayout smallBufferLayout, UniformLayout uniformLayout, TextureLayout textureLayout, SamplerLayout samplerLayout);
 	};
 }
\ No newline at end of file
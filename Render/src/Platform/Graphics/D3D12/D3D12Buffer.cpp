@@ -63,21 +63,27 @@ SampleRender::D3D12VertexBuffer::~D3D12VertexBuffer()
 {
 }
 
-void SampleRender::D3D12VertexBuffer::Stage() const
+void SampleRender::D3D12VertexBuffer::Stage(uint32_t bindingSlot) const
 {
 	auto cmdList = (*m_Context)->GetCurrentCommandList();
-	cmdList->IASetVertexBuffers(0, 1, &m_VertexBufferView);
+	cmdList->IASetVertexBuffers(bindingSlot, 1, &m_VertexBufferView);
 }
 
-SampleRender::D3D12IndexBuffer::D3D12IndexBuffer(const std::shared_ptr<D3D12Context>* context, const void* data, size_t count) :
+bool SampleRender::D3D12VertexBuffer::IsReady() const
+{
+	return true;
+}
+
+SampleRender::D3D12IndexBuffer::D3D12IndexBuffer(const std::shared_ptr<D3D12Context>* context, const void* data, size_t count, IndexFormat format) :
 	D3D12Buffer(context)
 {
-	CreateBuffer(data, count * sizeof(uint32_t));
+	CreateBuffer(data, count * IndexFormatSize(format));
 	m_Count = (uint32_t)count;
+	m_Format = format;
 
 	m_IndexBufferView.BufferLocation = m_Buffer->GetGPUVirtualAddress();
-	m_IndexBufferView.SizeInBytes = count * sizeof(uint32_t);
-	m_IndexBufferView.Format = DXGI_FORMAT_R32_UINT;
+	m_IndexBufferView.SizeInBytes = count * IndexFormatSize(format);
+	m_IndexBufferView.Format = (format == IndexFormat::Uint16) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
 }
 
 SampleRender::D3D12IndexBuffer::~D3D12IndexBuffer()
@@ -94,3 +100,34 @@ uint32_t SampleRender::D3D12IndexBuffer::GetCount() const
 {
 	return m_Count;
 }
+
+SampleRender::IndexFormat SampleRender::D3D12IndexBuffer::GetFormat() const
+{
+	return m_Format;
+}
+
+bool SampleRender::D3D12IndexBuffer::IsReady() const
+{
+	return true;
+}
+
+SampleRender::D3D12IndirectBuffer::D3D12IndirectBuffer(const std::shared_ptr<D3D12Context>* context, const void* data, size_t size) :
+	D3D12Buffer(context)
+{
+	//GENERIC_READ already covers INDIRECT_ARGUMENT
+	CreateBuffer(data, size);
+}
+
+SampleRender::D3D12IndirectBuffer::~D3D12IndirectBuffer()
+{
+}
+
+bool SampleRender::D3D12IndirectBuffer::IsReady() const
+{
+	return true;
+}
+
+ID3D12Resource2* SampleRender::D3D12IndirectBuffer::GetNativeBuffer() const
+{
+	return m_Buffer.GetConst();
+}
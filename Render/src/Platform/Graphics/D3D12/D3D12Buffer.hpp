@@ -22,7 +22,8 @@ namespace SampleRender
 		D3D12VertexBuffer(const std::shared_ptr<D3D12Context>* context, const void* data, size_t size, uint32_t stride);
 		~D3D12VertexBuffer();
 
-		virtual void Stage() const override;
+		virtual void Stage(uint32_t bindingSlot = 0) const override;
+		virtual bool IsReady() const override;
 
 	private:
 		D3D12_VERTEX_BUFFER_VIEW m_VertexBufferView;
@@ -31,13 +32,25 @@ namespace SampleRender
 	class SAMPLE_RENDER_DLL_COMMAND D3D12IndexBuffer : public IndexBuffer, public D3D12Buffer
 	{
 	public:
-		D3D12IndexBuffer(const std::shared_ptr<D3D12Context>* context, const void* data, size_t count);
+		D3D12IndexBuffer(const std::shared_ptr<D3D12Context>* context, const void* data, size_t count, IndexFormat format);
 		~D3D12IndexBuffer();
 
 		virtual void Stage() const override;
 		virtual uint32_t GetCount() const override;
+		virtual IndexFormat GetFormat() const override;
+		virtual bool IsReady() const override;
 
 	private:
 		D3D12_INDEX_BUFFER_VIEW m_IndexBufferView;
 	};
+
+	class SAMPLE_RENDER_DLL_COMMAND D3D12IndirectBuffer : public IndirectBuffer, public D3D12Buffer
+	{
+	public:
+		D3D12IndirectBuffer(const std::shared_ptr<D3D12Context>* context, const void* data, size_t size);
+		~D3D12IndirectBuffer();
+
+		virtual bool IsReady() const override;
+		ID3D12Resource2* GetNativeBuffer() const;
+	};
 }
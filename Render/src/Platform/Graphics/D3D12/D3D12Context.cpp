@@ -1,11 +1,16 @@
 #ifdef RENDER_USES_WINDOWS
 
 #include "D3D12Context.hpp"
+#include "D3D12Buffer.hpp"
 #include <cassert>
+#include <stdexcept>
 #include "Console.hpp"
 
-SampleRender::D3D12Context::D3D12Context(const Window* windowHandle, uint32_t framesInFlight) :
-	m_FramesInFlight(framesInFlight)
+const uint32_t SampleRender::D3D12Context::s_MaxTimestampScopes = 32;
+const uint64_t SampleRender::D3D12Context::s_DynamicFrameSize = 8 << 20;
+
+SampleRender::D3D12Context::D3D12Context(const Window* windowHandle, const GraphicsSettings& settings) :
+	m_FramesInFlight(settings.FramesInFlight), m_PresentMode(settings.Present), m_LowLatency(settings.LowLatency)
 {
 	SetClearColor(.0f, .5f, .25f, 1.0f);
 
@@ -23,11 +28,20 @@ SampleRender::D3D12Context::D3D12Context(const Window* windowHandle, uint32_t fr
 	CreateDepthStencilView();
 	CreateCommandAllocator();
 	CreateCommandList();
+	CreateTimestampQueries();
+	CreateCommandSignatures();
+	CreateDynamicBuffer();
 }
 
 SampleRender::D3D12Context::~D3D12Context()
 {
 	FlushQueue();
+	m_DynamicBuffer->Unmap(0, nullptr);
+	m_DynamicBuffer.Release();
+	m_DrawIndexedSignature.Release();
+	delete[] m_TimestampNames;
+	m_TimestampReadback.Release();
+	m_TimestampQueryHeap.Release();
 	delete[] m_CommandLists;
 	delete[] m_CommandAllocators;
 	m_DepthStencilView.Release();
@@ -59,9 +73,17 @@ uint32_t SampleRender::D3D12Context::GetSmallBufferAttachment() const
 	return 4;
 }
 
+void SampleRender::D3D12Context::PaceFrame()
+{
+	if (m_LowLatency)
+		WaitForSingleObjectEx(m_FrameLatencyWaitable, 100, TRUE);
+}
+
 void SampleRender::D3D12Context::ReceiveCommands()
 {
 	m_CurrentBufferIndex = m_SwapChain->GetCurrentBackBufferIndex();
+	m_DynamicHead = 0;
+	ReadTimestampQueries();
 	auto backBuffer = m_RenderTargets[m_CurrentBufferIndex];
 	auto rtvHandle = m_RTVHandles[m_CurrentBufferIndex];
 	auto dsvHandle = m_DSVHandle;
@@ -104,10 +126,20 @@ void SampleRender::D3D12Context::DispatchCommands()
 	rtSetupBarrier.Transition.Subresource = 0;
 	rtSetupBarrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
 
+	while (!m_OpenTimestamps.empty())
+		EndGPUTimestamp();
+
 	m_CommandLists[m_CurrentBufferIndex]->EndRenderPass();
 
 	m_CommandLists[m_CurrentBufferIndex]->ResourceBarrier(1, &rtSetupBarrier);
 
+	auto& names = m_TimestampNames[m_CurrentBufferIndex];
+	if (!names.empty())
+	{
+		UINT firstQuery = m_CurrentBufferIndex * s_MaxTimestampScopes * 2;
+		m_CommandLists[m_CurrentBufferIndex]->ResolveQueryData(m_TimestampQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, firstQuery, (UINT)names.size() * 2, m_TimestampReadback.Get(), firstQuery * sizeof(uint64_t));
+	}
+
 	// === Execute commands ===
 	auto hr = m_CommandLists[m_CurrentBufferIndex]->Close();
 
@@ -122,7 +154,19 @@ void SampleRender::D3D12Context::DispatchCommands()
 
 void SampleRender::D3D12Context::Present()
 {
-	m_SwapChain->Present(1, 0);
+	switch (m_PresentMode)
+	{
+	case PresentMode::IMMEDIATE:
+		m_SwapChain->Present(0, DXGI_PRESENT_ALLOW_TEARING);
+		break;
+	case PresentMode::MAILBOX:
+		//flip model without tearing, newer frames replace the queued one
+		m_SwapChain->Present(0, 0);
+		break;
+	default:
+		m_SwapChain->Present(1, 0);
+		break;
+	}
 }
 
 void SampleRender::D3D12Context::StageViewportAndScissors()
@@ -137,6 +181,46 @@ void SampleRender::D3D12Context::Draw(uint32_t elements)
 	m_CommandLists[m_CurrentBufferIndex]->DrawIndexedInstanced(elements, 1, 0, 0, 0);
 }
 
+void SampleRender::D3D12Context::DrawInstanced(uint32_t elements, uint32_t instances, uint32_t firstIndex, int32_t baseVertex, uint32_t firstInstance)
+{
+	m_CommandLists[m_CurrentBufferIndex]->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	m_CommandLists[m_CurrentBufferIndex]->DrawIndexedInstanced(elements, instances, firstIndex, baseVertex, firstInstance);
+}
+
+void SampleRender::D3D12Context::DrawIndexedIndirect(const IndirectBuffer* arguments, uint32_t drawCount, uint64_t argumentOffset)
+{
+	auto buffer = ((const D3D12IndirectBuffer*)arguments)->GetNativeBuffer();
+	m_CommandLists[m_CurrentBufferIndex]->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	m_CommandLists[m_CurrentBufferIndex]->ExecuteIndirect(m_DrawIndexedSignature.Get(), drawCount, buffer, argumentOffset, nullptr, 0);
+}
+
+void SampleRender::D3D12Context::DrawIndexedIndirectCount(const IndirectBuffer* arguments, const IndirectBuffer* countBuffer, uint32_t maxDraws, uint64_t argumentOffset, uint64_t countOffset)
+{
+	auto buffer = ((const D3D12IndirectBuffer*)arguments)->GetNativeBuffer();
+	auto count = ((const D3D12IndirectBuffer*)countBuffer)->GetNativeBuffer();
+	m_CommandLists[m_CurrentBufferIndex]->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	m_CommandLists[m_CurrentBufferIndex]->ExecuteIndirect(m_DrawIndexedSignature.Get(), maxDraws, buffer, argumentOffset, count, countOffset);
+}
+
+void SampleRender::D3D12Context::StageDynamicVertices(const void* data, size_t size, uint32_t stride, uint32_t bindingSlot)
+{
+	D3D12_VERTEX_BUFFER_VIEW vertexBufferView{};
+	vertexBufferView.BufferLocation = StageDynamicData(data, size);
+	vertexBufferView.SizeInBytes = (UINT)size;
+	vertexBufferView.StrideInBytes = stride;
+	m_CommandLists[m_CurrentBufferIndex]->IASetVertexBuffers(bindingSlot, 1, &vertexBufferView);
+}
+
+void SampleRender::D3D12Context::StageDynamicIndices(const void* data, uint32_t count, IndexFormat format)
+{
+	size_t size = (size_t)IndexFormatSize(format) * count;
+	D3D12_INDEX_BUFFER_VIEW indexBufferView{};
+	indexBufferView.BufferLocation = StageDynamicData(data, size);
+	indexBufferView.SizeInBytes = (UINT)size;
+	indexBufferView.Format = (format == IndexFormat::Uint16) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+	m_CommandLists[m_CurrentBufferIndex]->IASetIndexBuffer(&indexBufferView);
+}
+
 ID3D12Device10* SampleRender::D3D12Context::GetDevicePtr() const
 {
 	return m_Device.GetConst();
@@ -168,6 +252,72 @@ void SampleRender::D3D12Context::WindowResize(uint32_t width, uint32_t height)
 	CreateDepthStencilView();
 }
 
+uint32_t SampleRender::D3D12Context::SetRecordingWorkers(uint32_t workers)
+{
+	//D3D12 keeps recording on the frame command list
+	return 0;
+}
+
+void SampleRender::D3D12Context::BeginWorkerCommands(uint32_t worker)
+{
+}
+
+void SampleRender::D3D12Context::EndWorkerCommands(uint32_t worker)
+{
+}
+
+void SampleRender::D3D12Context::BeginGPUTimestamp(std::string_view name)
+{
+	auto& names = m_TimestampNames[m_CurrentBufferIndex];
+	if (names.size() >= s_MaxTimestampScopes)
+	{
+		m_OpenTimestamps.push_back(UINT32_MAX);
+		return;
+	}
+
+	uint32_t scope = (uint32_t)names.size();
+	names.push_back(std::string(name));
+	m_OpenTimestamps.push_back(scope);
+	m_CommandLists[m_CurrentBufferIndex]->EndQuery(m_TimestampQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, (m_CurrentBufferIndex * s_MaxTimestampScopes + scope) * 2);
+}
+
+void SampleRender::D3D12Context::EndGPUTimestamp()
+{
+	if (m_OpenTimestamps.empty())
+		return;
+
+	uint32_t scope = m_OpenTimestamps.back();
+	m_OpenTimestamps.pop_back();
+	if (scope == UINT32_MAX)
+		return;
+
+	m_CommandLists[m_CurrentBufferIndex]->EndQuery(m_TimestampQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, (m_CurrentBufferIndex * s_MaxTimestampScopes + scope) * 2 + 1);
+}
+
+const std::vector<SampleRender::GPUTimestampScope>& SampleRender::D3D12Context::GetGPUTimestamps() const
+{
+	return m_GPUTimestamps;
+}
+
+SampleRender::GPUMemoryStatistics SampleRender::D3D12Context::GetMemoryStatistics()
+{
+	//committed resources, placement and compaction are up to the driver
+	GPUMemoryStatistics statistics;
+	DXGI_QUERY_VIDEO_MEMORY_INFO memoryInfo{};
+	HRESULT hr = m_DXGIAdapter->QueryVideoMemoryInfo(0, DXGI_MEMORY_SEGMENT_GROUP_LOCAL, &memoryInfo);
+	if (hr == S_OK)
+	{
+		statistics.AllocatedBytes = memoryInfo.CurrentUsage;
+		statistics.ReservedBytes = memoryInfo.CurrentUsage;
+	}
+	return statistics;
+}
+
+void SampleRender::D3D12Context::WarmUpPipelines(ThreadPool* pool)
+{
+	//pipeline states are still built synchronously on D3D12, there is nothing to warm up
+}
+
 void SampleRender::D3D12Context::CreateFactory()
 {
 	HRESULT hr;
@@ -251,6 +401,7 @@ void SampleRender::D3D12Context::CreateSwapChain(HWND windowHandle)
 	swapChainDesc.SampleDesc.Count = 1;
 	swapChainDesc.SampleDesc.Quality = 0;
 	swapChainDesc.BufferUsage = DXGI_USAGE_BACK_BUFFER;
+	//the frame index is the back buffer index, SwapChainImages is not honored here
 	swapChainDesc.BufferCount = m_FramesInFlight;
 	swapChainDesc.Scaling = DXGI_SCALING_STRETCH;
 	swapChainDesc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_SEQUENTIAL;
@@ -267,6 +418,10 @@ void SampleRender::D3D12Context::CreateSwapChain(HWND windowHandle)
 	ComPointer<IDXGISwapChain1> swapChain;
 	m_DXGIFactory->CreateSwapChainForHwnd(m_CommandQueue.Get(), windowHandle, &swapChainDesc, &fullscreenDesc, nullptr, &swapChain);
 	swapChain->QueryInterface(IID_PPV_ARGS(m_SwapChain.GetAddressOf()));
+
+	if (m_LowLatency)
+		m_SwapChain->SetMaximumFrameLatency(1);
+	m_FrameLatencyWaitable = m_SwapChain->GetFrameLatencyWaitableObject();
 }
 
 void SampleRender::D3D12Context::CreateRenderTargetView()
@@ -389,6 +544,146 @@ void SampleRender::D3D12Context::CreateDepthStencilView()
 	m_Device->CreateDepthStencilView(m_DepthStencilView.Get(), &dsvDesc, m_DSVHandle);
 }
 
+void SampleRender::D3D12Context::CreateTimestampQueries()
+{
+	HRESULT hr;
+	m_TimestampNames = new std::vector<std::string>[m_FramesInFlight];
+
+	hr = m_CommandQueue->GetTimestampFrequency(&m_TimestampFrequency);
+	assert(hr == S_OK);
+
+	D3D12_QUERY_HEAP_DESC queryHeapDesc{};
+	queryHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+	queryHeapDesc.Count = m_FramesInFlight * s_MaxTimestampScopes * 2;
+	queryHeapDesc.NodeMask = 0;
+
+	hr = m_Device->CreateQueryHeap(&queryHeapDesc, IID_PPV_ARGS(m_TimestampQueryHeap.GetAddressOf()));
+	assert(hr == S_OK);
+
+	D3D12_RESOURCE_DESC1 readbackDesc = {};
+	readbackDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+	readbackDesc.Width = queryHeapDesc.Count * sizeof(uint64_t);
+	readbackDesc.Height = 1;
+	readbackDesc.DepthOrArraySize = 1;
+	readbackDesc.MipLevels = 1;
+	readbackDesc.Format = DXGI_FORMAT_UNKNOWN;
+	readbackDesc.SampleDesc.Count = 1;
+	readbackDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+	readbackDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+
+	D3D12_HEAP_PROPERTIES heapProps = {};
+	heapProps.Type = D3D12_HEAP_TYPE_READBACK;
+	heapProps.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+	heapProps.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+	heapProps.CreationNodeMask = 1;
+	heapProps.VisibleNodeMask = 1;
+
+	hr = m_Device->CreateCommittedResource2(
+		&heapProps,
+		D3D12_HEAP_FLAG_NONE,
+		&readbackDesc,
+		D3D12_RESOURCE_STATE_COPY_DEST,
+		nullptr,
+		nullptr,
+		IID_PPV_ARGS(m_TimestampReadback.GetAddressOf()));
+	assert(hr == S_OK);
+}
+
+void SampleRender::D3D12Context::CreateCommandSignatures()
+{
+	HRESULT hr;
+
+	D3D12_INDIRECT_ARGUMENT_DESC argumentDesc = {};
+	argumentDesc.Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED;
+
+	D3D12_COMMAND_SIGNATURE_DESC signatureDesc = {};
+	signatureDesc.ByteStride = sizeof(D3D12_DRAW_INDEXED_ARGUMENTS);
+	signatureDesc.NumArgumentDescs = 1;
+	signatureDesc.pArgumentDescs = &argumentDesc;
+	signatureDesc.NodeMask = 0;
+
+	//draw only signatures do not change root arguments, so no root signature is needed
+	hr = m_Device->CreateCommandSignature(&signatureDesc, nullptr, IID_PPV_ARGS(m_DrawIndexedSignature.GetAddressOf()));
+	assert(hr == S_OK);
+}
+
+void SampleRender::D3D12Context::CreateDynamicBuffer()
+{
+	HRESULT hr;
+
+	D3D12_RESOURCE_DESC1 bufferDesc = {};
+	bufferDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+	bufferDesc.Width = s_DynamicFrameSize * m_FramesInFlight;
+	bufferDesc.Height = 1;
+	bufferDesc.DepthOrArraySize = 1;
+	bufferDesc.MipLevels = 1;
+	bufferDesc.Format = DXGI_FORMAT_UNKNOWN;
+	bufferDesc.SampleDesc.Count = 1;
+	bufferDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+	bufferDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+
+	D3D12_HEAP_PROPERTIES heapProps = {};
+	heapProps.Type = D3D12_HEAP_TYPE_UPLOAD;
+	heapProps.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+	heapProps.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+	heapProps.CreationNodeMask = 1;
+	heapProps.VisibleNodeMask = 1;
+
+	hr = m_Device->CreateCommittedResource2(
+		&heapProps,
+		D3D12_HEAP_FLAG_NONE,
+		&bufferDesc,
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		nullptr,
+		IID_PPV_ARGS(m_DynamicBuffer.GetAddressOf()));
+	assert(hr == S_OK);
+
+	//upload heaps can stay mapped for the lifetime of the resource
+	D3D12_RANGE readRange = { 0, 0 };
+	hr = m_DynamicBuffer->Map(0, &readRange, (void**)&m_DynamicData);
+	assert(hr == S_OK);
+}
+
+D3D12_GPU_VIRTUAL_ADDRESS SampleRender::D3D12Context::StageDynamicData(const void* data, size_t size)
+{
+	//constant buffer alignment, wide enough for vertex and index data too
+	uint64_t alignedSize = (size + D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT - 1) & ~((uint64_t)D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT - 1);
+	if (m_DynamicHead + alignedSize > s_DynamicFrameSize)
+		throw std::runtime_error("dynamic buffer ran out of space!");
+
+	uint64_t offset = m_CurrentBufferIndex * s_DynamicFrameSize + m_DynamicHead;
+	m_DynamicHead += alignedSize;
+	memcpy(m_DynamicData + offset, data, size);
+	return m_DynamicBuffer->GetGPUVirtualAddress() + offset;
+}
+
+void SampleRender::D3D12Context::ReadTimestampQueries()
+{
+	//the previous use of this back buffer was already flushed, so the resolved data is on the host
+	auto& names = m_TimestampNames[m_CurrentBufferIndex];
+	if (names.empty())
+		return;
+
+	size_t firstQuery = m_CurrentBufferIndex * s_MaxTimestampScopes * 2;
+	D3D12_RANGE readRange = { firstQuery * sizeof(uint64_t), (firstQuery + names.size() * 2) * sizeof(uint64_t) };
+	D3D12_RANGE writeRange = { 0, 0 };
+	uint64_t* ticks = nullptr;
+	HRESULT hr = m_TimestampReadback->Map(0, &readRange, (void**)&ticks);
+	if (hr == S_OK)
+	{
+		m_GPUTimestamps.clear();
+		for (size_t i = 0; i < names.size(); i++)
+		{
+			uint64_t begin = ticks[firstQuery + i * 2];
+			uint64_t end = ticks[firstQuery + i * 2 + 1];
+			m_GPUTimestamps.push_back({ names[i], (double)(end - begin) * 1000.0 / (double)m_TimestampFrequency });
+		}
+		m_TimestampReadback->Unmap(0, &writeRange);
+	}
+	names.clear();
+}
+
 void SampleRender::D3D12Context::GetTargets()
 {
 	HRESULT hr;
@@ -423,8 +718,9 @@ void SampleRender::D3D12Context::WaitForFence(UINT64 fenceValue)
 		// Fallback wait
 		while (m_CommandQueueFence->GetCompletedValue() < fenceValue) Sleep(1);
 	}
-	auto waitable = m_SwapChain->GetFrameLatencyWaitableObject();
-	WaitForMultipleObjects(1, &waitable, TRUE, INFINITE);
+	//low latency mode already waits on it once per frame in PaceFrame
+	if (!m_LowLatency)
+		WaitForMultipleObjects(1, &m_FrameLatencyWaitable, TRUE, INFINITE);
 }
 
 #ifdef RENDER_DEBUG_MODE
@@ -19,13 +19,14 @@ namespace SampleRender
 	class SAMPLE_RENDER_DLL_COMMAND D3D12Context : public GraphicsContext
 	{
 	public:
-		D3D12Context(const Window* windowHandle, uint32_t framesInFlight);
+		D3D12Context(const Window* windowHandle, const GraphicsSettings& settings);
 		~D3D12Context();
 
 		void SetClearColor(float r, float g, float b, float a) override;
 
 		uint32_t GetUniformAttachment() const override;
 
+		void PaceFrame() override;
 		void ReceiveCommands() override;
 		void DispatchCommands() override;
 		void Present() override;
@@ -34,6 +35,11 @@ namespace SampleRender
 		uint32_t GetSmallBufferAttachment() const override;
 
 		void Draw(uint32_t elements) override;
+		void DrawInstanced(uint32_t elements, uint32_t instances, uint32_t firstIndex = 0, int32_t baseVertex = 0, uint32_t firstInstance = 0) override;
+		void DrawIndexedIndirect(const IndirectBuffer* arguments, uint32_t drawCount, uint64_t argumentOffset = 0) override;
+		void DrawIndexedIndirectCount(const IndirectBuffer* arguments, const IndirectBuffer* countBuffer, uint32_t maxDraws, uint64_t argumentOffset = 0, uint64_t countOffset = 0) override;
+		void StageDynamicVertices(const void* data, size_t size, uint32_t stride, uint32_t bindingSlot = 0) override;
+		void StageDynamicIndices(const void* data, uint32_t count, IndexFormat format) override;
 
 		ID3D12Device10* GetDevicePtr() const;
 		ID3D12GraphicsCommandList6* GetCurrentCommandList() const;
@@ -41,6 +47,17 @@ namespace SampleRender
 		const std::string GetGPUName() override;
 
 		void WindowResize(uint32_t width, uint32_t height) override;
+
+		uint32_t SetRecordingWorkers(uint32_t workers) override;
+		void BeginWorkerCommands(uint32_t worker) override;
+		void EndWorkerCommands(uint32_t worker) override;
+
+		void BeginGPUTimestamp(std::string_view name) override;
+		void EndGPUTimestamp() override;
+		const std::vector<GPUTimestampScope>& GetGPUTimestamps() const override;
+		GPUMemoryStatistics GetMemoryStatistics() override;
+
+		void WarmUpPipelines(ThreadPool* pool) override;
 	
 	private:
 		void CreateFactory();
@@ -53,6 +70,12 @@ namespace SampleRender
 		void CreateCommandList();
 		void CreateViewportAndScissor(uint32_t width, uint32_t height);
 		void CreateDepthStencilView();
+		void CreateTimestampQueries();
+		void ReadTimestampQueries();
+		void CreateCommandSignatures();
+		void CreateDynamicBuffer();
+		//Returns the GPU address of size bytes in the current frame region of the dynamic buffer
+		D3D12_GPU_VIRTUAL_ADDRESS StageDynamicData(const void* data, size_t size);
 
 		void GetTargets();
 		void FlushQueue(size_t flushCount = 1);
@@ -88,12 +111,31 @@ namespace SampleRender
 		ComPointer<ID3D12Resource2> m_DepthStencilView;
 		D3D12_CPU_DESCRIPTOR_HANDLE m_DSVHandle;
 		uint32_t m_FramesInFlight;
+		PresentMode m_PresentMode;
+		bool m_LowLatency;
+		HANDLE m_FrameLatencyWaitable = nullptr;
 		D3D12_CLEAR_VALUE m_ClearColor;
 
 		ComPointer<ID3D12CommandAllocator>* m_CommandAllocators;
 		ComPointer<ID3D12GraphicsCommandList6>* m_CommandLists;
 
 		UINT m_CurrentBufferIndex = -1;
+
+		static const uint32_t s_MaxTimestampScopes;
+		ComPointer<ID3D12QueryHeap> m_TimestampQueryHeap;
+		ComPointer<ID3D12Resource2> m_TimestampReadback;
+		uint64_t m_TimestampFrequency = 0;
+		std::vector<std::string>* m_TimestampNames;
+		std::vector<uint32_t> m_OpenTimestamps;
+		std::vector<GPUTimestampScope> m_GPUTimestamps;
+
+		ComPointer<ID3D12CommandSignature> m_DrawIndexedSignature;
+
+		//Upload heap split in a region per frame, the queue is flushed every frame so a region is free once its index comes back
+		static const uint64_t s_DynamicFrameSize;
+		ComPointer<ID3D12Resource2> m_DynamicBuffer;
+		uint8_t* m_DynamicData = nullptr;
+		uint64_t m_DynamicHead = 0;
 	};
 }
 
@@ -38,10 +38,10 @@ SampleRender::D3D12Shader::D3D12Shader(const std::shared_ptr<D3D12Context>* cont
 		ied[i].SemanticName = nativeElements[i].GetName().c_str();
 		ied[i].SemanticIndex = 0;
 		ied[i].Format = GetNativeFormat(nativeElements[i].GetType());
-		ied[i].InputSlot = 0;
+		ied[i].InputSlot = nativeElements[i].GetBufferSlot();
 		ied[i].AlignedByteOffset = nativeElements[i].GetOffset();
-		ied[i].InputSlotClass = D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA;
-		ied[i].InstanceDataStepRate = 0;
+		ied[i].InputSlotClass = GetNativeInputClassification(nativeElements[i].GetInputRate());
+		ied[i].InstanceDataStepRate = (nativeElements[i].GetInputRate() == InputRate::Instance) ? 1 : 0;
 	}
 
 	CreateGraphicsRootSignature(m_RootSignature.GetAddressOf(), device);
@@ -125,6 +125,11 @@ uint32_t SampleRender::D3D12Shader::GetOffset() const
 	return 0;
 }
 
+bool SampleRender::D3D12Shader::IsReady() const
+{
+	return true;
+}
+
 void SampleRender::D3D12Shader::BindSmallBuffer(const void* data, size_t size, uint32_t bindingSlot)
 {
 	if(size != m_SmallBufferLayout.GetElement(bindingSlot).GetSize())
@@ -149,6 +154,17 @@ void SampleRender::D3D12Shader::BindTexture(uint32_t shaderRegister)
 	cmdList->SetGraphicsRootDescriptorTable(shaderRegister, m_Textures[shaderRegister].Heap->GetGPUDescriptorHandleForHeapStart());
 }
 
+uint32_t SampleRender::D3D12Shader::GetTextureIndex(uint32_t shaderRegister) const
+{
+	//textures stay in per-register descriptor tables
+	return shaderRegister;
+}
+
+uint32_t SampleRender::D3D12Shader::GetSamplerIndex(uint32_t shaderRegister) const
+{
+	return shaderRegister;
+}
+
 void SampleRender::D3D12Shader::CreateCopyPipeline()
 {
 	auto device = (*m_Context)->GetDevicePtr();
@@ -613,6 +629,16 @@ void SampleRender::D3D12Shader::InitJsonAndPaths(std::string json_controller_pat
 	m_ShaderDir = location.parent_path().string();
 }
 
+D3D12_INPUT_CLASSIFICATION SampleRender::D3D12Shader::GetNativeInputClassification(InputRate rate)
+{
+	switch (rate)
+	{
+		case InputRate::Instance: return D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA;
+		case InputRate::Vertex:
+		default: return D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA;
+	}
+}
+
 DXGI_FORMAT SampleRender::D3D12Shader::GetNativeFormat(ShaderDataType type)
 {
 	switch (type)
@@ -626,6 +652,21 @@ DXGI_FORMAT SampleRender::D3D12Shader::GetNativeFormat(ShaderDataType type)
 		case ShaderDataType::Uint3: return DXGI_FORMAT_R32G32B32_UINT;
 		case ShaderDataType::Uint4: return DXGI_FORMAT_R32G32B32A32_UINT;
 		case ShaderDataType::Bool: return DXGI_FORMAT_R8_UINT;
+		case ShaderDataType::Half2: return DXGI_FORMAT_R16G16_FLOAT;
+		case ShaderDataType::Half4: return DXGI_FORMAT_R16G16B16A16_FLOAT;
+		case ShaderDataType::Byte4: return DXGI_FORMAT_R8G8B8A8_SINT;
+		case ShaderDataType::Byte4Norm: return DXGI_FORMAT_R8G8B8A8_SNORM;
+		case ShaderDataType::Ubyte4: return DXGI_FORMAT_R8G8B8A8_UINT;
+		case ShaderDataType::Ubyte4Norm: return DXGI_FORMAT_R8G8B8A8_UNORM;
+		case ShaderDataType::Short2: return DXGI_FORMAT_R16G16_SINT;
+		case ShaderDataType::Short2Norm: return DXGI_FORMAT_R16G16_SNORM;
+		case ShaderDataType::Short4: return DXGI_FORMAT_R16G16B16A16_SINT;
+		case ShaderDataType::Short4Norm: return DXGI_FORMAT_R16G16B16A16_SNORM;
+		case ShaderDataType::Ushort2: return DXGI_FORMAT_R16G16_UINT;
+		case ShaderDataType::Ushort2Norm: return DXGI_FORMAT_R16G16_UNORM;
+		case ShaderDataType::Ushort4: return DXGI_FORMAT_R16G16B16A16_UINT;
+		case ShaderDataType::Ushort4Norm: return DXGI_FORMAT_R16G16B16A16_UNORM;
+		case ShaderDataType::Uint1010102Norm: return DXGI_FORMAT_R10G10B10A2_UNORM;
 		default: return DXGI_FORMAT_UNKNOWN;
 	}
 }
@@ -23,10 +23,13 @@ namespace SampleRender
 		void Stage() override;
 		uint32_t GetStride() const override;
 		uint32_t GetOffset() const override;
+		bool IsReady() const override;
 
 		void BindSmallBuffer(const void* data, size_t size, uint32_t bindingSlot) override;
 		void BindUniforms(const void* data, size_t size, uint32_t shaderRegister) override;
 		void BindTexture(uint32_t shaderRegister) override;
+		uint32_t GetTextureIndex(uint32_t shaderRegister) const override;
+		uint32_t GetSamplerIndex(uint32_t shaderRegister) const override;
 
 	private:
 		void CreateCopyPipeline();
@@ -56,6 +59,7 @@ namespace SampleRender
 		void InitJsonAndPaths(std::string json_controller_path);
 
 		static DXGI_FORMAT GetNativeFormat(ShaderDataType type);
+		static D3D12_INPUT_CLASSIFICATION GetNativeInputClassification(InputRate rate);
 		static D3D12_DESCRIPTOR_HEAP_TYPE GetNativeHeapType(BufferType type);
 		static D3D12_RESOURCE_DIMENSION GetNativeDimension(BufferType type);
 
@@ -0,0 +1,163 @@
+#include "VKBindlessHeap.hpp"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <stdexcept>
+
+const uint32_t SampleRender::VKBindlessHeap::s_SetIndex = 1;
+const uint32_t SampleRender::VKBindlessHeap::s_MaxTextures = 16384;
+const uint32_t SampleRender::VKBindlessHeap::s_MaxSamplers = 1024;
+
+SampleRender::VKBindlessHeap::VKBindlessHeap(VKContext* context) :
+    m_Context(context)
+{
+    VkResult vkr;
+    auto device = m_Context->GetDevice();
+
+    VkPhysicalDeviceVulkan12Properties vulkan12Properties{};
+    vulkan12Properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+    VkPhysicalDeviceProperties2 properties{};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &vulkan12Properties;
+    vkGetPhysicalDeviceProperties2(m_Context->GetAdapter(), &properties);
+
+    m_Textures.Capacity = std::min({ s_MaxTextures, vulkan12Properties.maxDescriptorSetUpdateAfterBindSampledImages, vulkan12Properties.maxPerStageDescriptorUpdateAfterBindSampledImages });
+    m_Samplers.Capacity = std::min({ s_MaxSamplers, vulkan12Properties.maxDescriptorSetUpdateAfterBindSamplers, vulkan12Properties.maxPerStageDescriptorUpdateAfterBindSamplers });
+
+    std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    bindings[0].descriptorCount = m_Textures.Capacity;
+    bindings[0].stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS;
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+    bindings[1].descriptorCount = m_Samplers.Capacity;
+    bindings[1].stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS;
+
+    //slots that were never written or were released stay out of the way of pending frames
+    std::array<VkDescriptorBindingFlags, 2> bindingFlags;
+    bindingFlags.fill(VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT);
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+    bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    bindingFlagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+    bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.pNext = &bindingFlagsInfo;
+    layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+
+    vkr = vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &m_Layout);
+    assert(vkr == VK_SUCCESS);
+
+    //update-after-bind layouts need a pool of their own, the shared descriptor allocator pools lack the flag
+    std::array<VkDescriptorPoolSize, 2> poolSizes{};
+    poolSizes[0] = { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, m_Textures.Capacity };
+    poolSizes[1] = { VK_DESCRIPTOR_TYPE_SAMPLER, m_Samplers.Capacity };
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = 1;
+
+    vkr = vkCreateDescriptorPool(device, &poolInfo, nullptr, &m_Pool);
+    assert(vkr == VK_SUCCESS);
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = m_Pool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &m_Layout;
+
+    vkr = vkAllocateDescriptorSets(device, &allocInfo, &m_Set);
+    assert(vkr == VK_SUCCESS);
+}
+
+SampleRender::VKBindlessHeap::~VKBindlessHeap()
+{
+    //the owner idles the device first
+    auto device = m_Context->GetDevice();
+    vkDestroyDescriptorPool(device, m_Pool, nullptr);
+    vkDestroyDescriptorSetLayout(device, m_Layout, nullptr);
+}
+
+uint32_t SampleRender::VKBindlessHeap::RegisterTexture(VkImageView view)
+{
+    std::lock_guard<std::mutex> lock(m_HeapMutex);
+    uint32_t index = AcquireSlot(m_Textures);
+    WriteDescriptor(0, index, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, view, VK_NULL_HANDLE);
+    return index;
+}
+
+void SampleRender::VKBindlessHeap::UpdateTexture(uint32_t index, VkImageView view)
+{
+    std::lock_guard<std::mutex> lock(m_HeapMutex);
+    WriteDescriptor(0, index, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, view, VK_NULL_HANDLE);
+}
+
+void SampleRender::VKBindlessHeap::ReleaseTexture(uint32_t index)
+{
+    std::lock_guard<std::mutex> lock(m_HeapMutex);
+    m_Textures.Free.push_back(index);
+}
+
+uint32_t SampleRender::VKBindlessHeap::RegisterSampler(VkSampler sampler)
+{
+    std::lock_guard<std::mutex> lock(m_HeapMutex);
+    uint32_t index = AcquireSlot(m_Samplers);
+    WriteDescriptor(1, index, VK_DESCRIPTOR_TYPE_SAMPLER, VK_NULL_HANDLE, sampler);
+    return index;
+}
+
+void SampleRender::VKBindlessHeap::ReleaseSampler(uint32_t index)
+{
+    std::lock_guard<std::mutex> lock(m_HeapMutex);
+    m_Samplers.Free.push_back(index);
+}
+
+void SampleRender::VKBindlessHeap::Bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout) const
+{
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, s_SetIndex, 1, &m_Set, 0, nullptr);
+}
+
+VkDescriptorSetLayout SampleRender::VKBindlessHeap::GetLayout() const
+{
+    return m_Layout;
+}
+
+uint32_t SampleRender::VKBindlessHeap::AcquireSlot(SlotList& slots)
+{
+    if (!slots.Free.empty())
+    {
+        uint32_t index = slots.Free.back();
+        slots.Free.pop_back();
+        return index;
+    }
+    if (slots.Next >= slots.Capacity)
+        throw std::runtime_error("bindless heap is full!");
+    return slots.Next++;
+}
+
+void SampleRender::VKBindlessHeap::WriteDescriptor(uint32_t binding, uint32_t index, VkDescriptorType type, VkImageView view, VkSampler sampler)
+{
+    VkDescriptorImageInfo imageInfo{};
+    imageInfo.imageLayout = (view != VK_NULL_HANDLE) ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.imageView = view;
+    imageInfo.sampler = sampler;
+
+    VkWriteDescriptorSet descriptorWrite{};
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet = m_Set;
+    descriptorWrite.dstBinding = binding;
+    descriptorWrite.dstArrayElement = index;
+    descriptorWrite.descriptorType = type;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.pImageInfo = &imageInfo;
+
+    vkUpdateDescriptorSets(m_Context->GetDevice(), 1, &descriptorWrite, 0, nullptr);
+}
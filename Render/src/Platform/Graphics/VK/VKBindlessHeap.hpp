@@ -0,0 +1,54 @@
+#pragma once
+
+#include "VKContext.hpp"
+#include <vector>
+#include <mutex>
+
+namespace SampleRender
+{
+	//One partially bound, update-after-bind set holding every sampled texture and sampler of the context
+	//Shaders see it at set s_SetIndex, textures in binding 0 and samplers in binding 1, both as runtime arrays
+	class SAMPLE_RENDER_DLL_COMMAND VKBindlessHeap
+	{
+	public:
+		VKBindlessHeap(VKContext* context);
+		~VKBindlessHeap();
+
+		//The slot never holds a descriptor in use by pending work, so it can be written while frames are in flight
+		uint32_t RegisterTexture(VkImageView view);
+		//Only while the GPU is idle, the old view may still be read otherwise
+		void UpdateTexture(uint32_t index, VkImageView view);
+		//Deferred by the caller until no frame can index the slot
+		void ReleaseTexture(uint32_t index);
+
+		uint32_t RegisterSampler(VkSampler sampler);
+		void ReleaseSampler(uint32_t index);
+
+		void Bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout) const;
+		VkDescriptorSetLayout GetLayout() const;
+
+		static const uint32_t s_SetIndex;
+
+	private:
+		struct SlotList
+		{
+			uint32_t Capacity;
+			uint32_t Next = 0;
+			std::vector<uint32_t> Free;
+		};
+
+		uint32_t AcquireSlot(SlotList& slots);
+		void WriteDescriptor(uint32_t binding, uint32_t index, VkDescriptorType type, VkImageView view, VkSampler sampler);
+
+		static const uint32_t s_MaxTextures;
+		static const uint32_t s_MaxSamplers;
+
+		VKContext* m_Context;
+		std::mutex m_HeapMutex;
+		VkDescriptorSetLayout m_Layout;
+		VkDescriptorPool m_Pool;
+		VkDescriptorSet m_Set;
+		SlotList m_Textures;
+		SlotList m_Samplers;
+	};
+}
@@ -1,169 +1,174 @@
 #include "VKBuffer.hpp"
+#include "VKUploadManager.hpp"
 #include <stdexcept>
 #include <cassert>
+#include <cstring>
 
 SampleRender::VKBuffer::VKBuffer(const std::shared_ptr<VKContext>* context) :
     m_Context(context)
 {
 }
 
-void SampleRender::VKBuffer::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+void SampleRender::VKBuffer::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VKAllocation& bufferMemory)
 {
     VkResult vkr;
     auto device = (*m_Context)->GetDevice();
     
+    //transfer source lets defragmentation copy the contents into a new range
+    m_BufferSize = size;
+    m_BufferUsage = usage | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
     VkBufferCreateInfo bufferInfo{};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    bufferInfo.size = size;
-    bufferInfo.usage = usage;
+    bufferInfo.size = m_BufferSize;
+    bufferInfo.usage = m_BufferUsage;
     bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
     vkr = vkCreateBuffer(device, &bufferInfo, nullptr, &buffer);
     assert(vkr == VK_SUCCESS);
 
-    VkMemoryRequirements memRequirements;
-    vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
-
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, properties);
-
-    vkr = vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory);
-    assert(vkr == VK_SUCCESS);
-    vkBindBufferMemory(device, buffer, bufferMemory, 0);
+    bufferMemory = (*m_Context)->GetMemoryAllocator()->AllocateBuffer(buffer, properties);
+    if (properties & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+        (*m_Context)->GetMemoryAllocator()->SetRelocatable(bufferMemory, this);
 }
 
-void SampleRender::VKBuffer::CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size)
+void SampleRender::VKBuffer::ReleaseBuffer()
 {
-    auto commandPool = (*m_Context)->GetCommandPool();
     auto device = (*m_Context)->GetDevice();
-    auto graphicsQueue = (*m_Context)->GetGraphicsQueue();
-
-    VkCommandBufferAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandPool = commandPool;
-    allocInfo.commandBufferCount = 1;
-
-    VkCommandBuffer commandBuffer;
-    vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
-
-    VkCommandBufferBeginInfo beginInfo{};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-    vkBeginCommandBuffer(commandBuffer, &beginInfo);
-
-    VkBufferCopy copyRegion{};
-    copyRegion.size = size;
-    vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-    vkEndCommandBuffer(commandBuffer);
-
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffer;
-
-    vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(graphicsQueue);
-
-    vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+    VkBuffer buffer = m_Buffer;
+    VKAllocation bufferMemory = m_BufferMemory;
+    VKMemoryAllocator* allocator = (*m_Context)->GetMemoryAllocator();
+    allocator->ClearRelocatable(bufferMemory);
+    (*m_Context)->EnqueueDestruction([device, buffer, bufferMemory, allocator]()
+    {
+        vkDestroyBuffer(device, buffer, nullptr);
+        allocator->Free(bufferMemory);
+    });
 }
 
-uint32_t SampleRender::VKBuffer::FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
+void SampleRender::VKBuffer::UploadData(const void* data, VkDeviceSize size)
 {
-    auto adapter = (*m_Context)->GetAdapter();
-    VkPhysicalDeviceMemoryProperties memProperties;
-    vkGetPhysicalDeviceMemoryProperties(adapter, &memProperties);
-
-    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-        if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-            return i;
-        }
+    if (m_BufferMemory.MappedData != nullptr)
+    {
+        //coherent memory, the next queue submission makes the write visible to the GPU
+        memcpy(m_BufferMemory.MappedData, data, size);
+        m_UploadTicket = 0;
+        return;
     }
+    m_UploadTicket = (*m_Context)->GetUploadManager()->UploadBuffer(m_Buffer, data, size);
+}
 
-    assert(false);
-    return 0xffffffffu;
+bool SampleRender::VKBuffer::CanRelocate(bool gpuIdle, uint64_t completedUpload) const
+{
+    //shaders may still be writing the current buffer, the copy would lose those writes
+    if ((m_BufferUsage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT) && !gpuIdle)
+        return false;
+    //the staging copy still targets the current buffer
+    return m_UploadTicket <= completedUpload;
 }
 
-SampleRender::VKVertexBuffer::VKVertexBuffer(const std::shared_ptr<VKContext>* context, const void* data, size_t size, uint32_t stride) :
-    VKBuffer(context)
+void SampleRender::VKBuffer::Relocate(VkCommandBuffer commandBuffer, const VKAllocation& oldMemory, const VKAllocation& newMemory)
 {
     VkResult vkr;
     auto device = (*m_Context)->GetDevice();
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
 
-    void* mappedData;
-    vkr = vkMapMemory(device, stagingBufferMemory, 0, size, 0, &mappedData);
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = m_BufferSize;
+    bufferInfo.usage = m_BufferUsage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VkBuffer buffer;
+    vkr = vkCreateBuffer(device, &bufferInfo, nullptr, &buffer);
+    assert(vkr == VK_SUCCESS);
+    vkr = vkBindBufferMemory(device, buffer, newMemory.Memory, newMemory.Offset);
     assert(vkr == VK_SUCCESS);
-    memcpy(mappedData, data, size);
-    vkUnmapMemory(device, stagingBufferMemory);
 
-    CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_Buffer, m_BufferMemory);
+    //the upload copy wrote the source, it has to land before the relocation reads it
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = m_Buffer;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+    VkBufferCopy region{};
+    region.size = m_BufferSize;
+    vkCmdCopyBuffer(commandBuffer, m_Buffer, buffer, 1, &region);
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+    barrier.buffer = buffer;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+    //frames already submitted keep reading the old buffer
+    VkBuffer oldBuffer = m_Buffer;
+    VKMemoryAllocator* allocator = (*m_Context)->GetMemoryAllocator();
+    (*m_Context)->EnqueueDestruction([device, oldBuffer, oldMemory, allocator]()
+    {
+        vkDestroyBuffer(device, oldBuffer, nullptr);
+        allocator->Free(oldMemory);
+    });
+
+    m_Buffer = buffer;
+    m_BufferMemory = newMemory;
+}
 
-    CopyBuffer(stagingBuffer, m_Buffer, size);
+bool SampleRender::VKBuffer::IsUploadComplete() const
+{
+    return (*m_Context)->GetUploadManager()->IsUploadComplete(m_UploadTicket);
+}
 
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingBufferMemory, nullptr);
+SampleRender::VKVertexBuffer::VKVertexBuffer(const std::shared_ptr<VKContext>* context, const void* data, size_t size, uint32_t stride) :
+    VKBuffer(context)
+{
+    CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, (*m_Context)->GetMemoryAllocator()->GetDeviceLocalProperties(), m_Buffer, m_BufferMemory);
+    UploadData(data, size);
 }
 
 SampleRender::VKVertexBuffer::~VKVertexBuffer()
 {
-    auto device = (*m_Context)->GetDevice();
-    vkDeviceWaitIdle(device);
-    vkDestroyBuffer(device, m_Buffer, nullptr);
-    vkFreeMemory(device, m_BufferMemory, nullptr);
+    ReleaseBuffer();
 }
 
-void SampleRender::VKVertexBuffer::Stage() const
+void SampleRender::VKVertexBuffer::Stage(uint32_t bindingSlot) const
 {
     auto commandBuffer = (*m_Context)->GetCurrentCommandBuffer();
     VkDeviceSize offset = 0;
-    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &m_Buffer, &offset);
+    vkCmdBindVertexBuffers(commandBuffer, bindingSlot, 1, &m_Buffer, &offset);
+}
+
+bool SampleRender::VKVertexBuffer::IsReady() const
+{
+    return IsUploadComplete();
 }
 
-SampleRender::VKIndexBuffer::VKIndexBuffer(const std::shared_ptr<VKContext>* context, const void* data, size_t count) :
+SampleRender::VKIndexBuffer::VKIndexBuffer(const std::shared_ptr<VKContext>* context, const void* data, size_t count, IndexFormat format) :
     VKBuffer(context)
 {
     m_Count = (uint32_t)count;
+    m_Format = format;
 
-    auto device = (*m_Context)->GetDevice();
-
-    VkDeviceSize bufferSize = sizeof(uint32_t) * m_Count;
-
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+    VkDeviceSize bufferSize = IndexFormatSize(m_Format) * m_Count;
 
-    void* mappedData;
-    vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &mappedData);
-    memcpy(mappedData, data, (size_t)bufferSize);
-    vkUnmapMemory(device, stagingBufferMemory);
-
-    CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_Buffer, m_BufferMemory);
-
-    CopyBuffer(stagingBuffer, m_Buffer, bufferSize);
-
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingBufferMemory, nullptr);
+    CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, (*m_Context)->GetMemoryAllocator()->GetDeviceLocalProperties(), m_Buffer, m_BufferMemory);
+    UploadData(data, bufferSize);
 }
 
 SampleRender::VKIndexBuffer::~VKIndexBuffer()
 {
-    auto device = (*m_Context)->GetDevice();
-    vkDeviceWaitIdle(device);
-    vkDestroyBuffer(device, m_Buffer, nullptr);
-    vkFreeMemory(device, m_BufferMemory, nullptr);
+    ReleaseBuffer();
 }
 
 void SampleRender::VKIndexBuffer::Stage() const
 {
     auto commandBuffer = (*m_Context)->GetCurrentCommandBuffer();
-    vkCmdBindIndexBuffer(commandBuffer, m_Buffer, 0, VK_INDEX_TYPE_UINT32);
+    VkIndexType indexType = (m_Format == IndexFormat::Uint16) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+    vkCmdBindIndexBuffer(commandBuffer, m_Buffer, 0, indexType);
 }
 
 uint32_t SampleRender::VKIndexBuffer::GetCount() const
@@ -171,4 +176,35 @@ uint32_t SampleRender::VKIndexBuffer::GetCount() const
 	return m_Count;
 }
 
+SampleRender::IndexFormat SampleRender::VKIndexBuffer::GetFormat() const
+{
+    return m_Format;
+}
 
+bool SampleRender::VKIndexBuffer::IsReady() const
+{
+    return IsUploadComplete();
+}
+
+SampleRender::VKIndirectBuffer::VKIndirectBuffer(const std::shared_ptr<VKContext>* context, const void* data, size_t size) :
+    VKBuffer(context)
+{
+    //storage usage lets compute passes fill the arguments on the GPU
+    CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, (*m_Context)->GetMemoryAllocator()->GetDeviceLocalProperties(), m_Buffer, m_BufferMemory);
+    UploadData(data, size);
+}
+
+SampleRender::VKIndirectBuffer::~VKIndirectBuffer()
+{
+    ReleaseBuffer();
+}
+
+bool SampleRender::VKIndirectBuffer::IsReady() const
+{
+    return IsUploadComplete();
+}
+
+VkBuffer SampleRender::VKIndirectBuffer::GetNativeBuffer() const
+{
+    return m_Buffer;
+}
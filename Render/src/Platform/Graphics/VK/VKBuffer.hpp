@@ -6,17 +6,26 @@
 
 namespace SampleRender
 {
-	class SAMPLE_RENDER_DLL_COMMAND VKBuffer
+	class SAMPLE_RENDER_DLL_COMMAND VKBuffer : public VKRelocatable
 	{
+	public:
+		bool CanRelocate(bool gpuIdle, uint64_t completedUpload) const override;
+		void Relocate(VkCommandBuffer commandBuffer, const VKAllocation& oldMemory, const VKAllocation& newMemory) override;
+
 	protected:
 		VKBuffer(const std::shared_ptr<VKContext>* context);
-		void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
-		void CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
-		uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+		void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VKAllocation& bufferMemory);
+		void ReleaseBuffer();
+		//Writes straight into the buffer when its memory is mapped, goes through the upload manager otherwise
+		void UploadData(const void* data, VkDeviceSize size);
+		bool IsUploadComplete() const;
 
 		const std::shared_ptr<VKContext>* m_Context;
 		VkBuffer m_Buffer;
-		VkDeviceMemory m_BufferMemory;
+		VKAllocation m_BufferMemory;
+		VkDeviceSize m_BufferSize = 0;
+		VkBufferUsageFlags m_BufferUsage = 0;
+		uint64_t m_UploadTicket = 0;
 	};
 
 	class SAMPLE_RENDER_DLL_COMMAND VKVertexBuffer : public VertexBuffer, public VKBuffer
@@ -25,7 +34,8 @@ namespace SampleRender
 		VKVertexBuffer(const std::shared_ptr<VKContext>* context, const void* data, size_t size, uint32_t stride);
 		~VKVertexBuffer();
 
-		virtual void Stage() const override;
+		virtual void Stage(uint32_t bindingSlot = 0) const override;
+		virtual bool IsReady() const override;
 
 	private:
 
@@ -34,13 +44,25 @@ namespace SampleRender
 	class SAMPLE_RENDER_DLL_COMMAND VKIndexBuffer : public IndexBuffer, public VKBuffer
 	{
 	public:
-		VKIndexBuffer(const std::shared_ptr<VKContext>* context, const void* data, size_t count);
+		VKIndexBuffer(const std::shared_ptr<VKContext>* context, const void* data, size_t count, IndexFormat format);
 		~VKIndexBuffer();
 
 		virtual void Stage() const override;
 		virtual uint32_t GetCount() const override;
+		virtual IndexFormat GetFormat() const override;
+		virtual bool IsReady() const override;
 
 	private:
 
 	};
+
+	class SAMPLE_RENDER_DLL_COMMAND VKIndirectBuffer : public IndirectBuffer, public VKBuffer
+	{
+	public:
+		VKIndirectBuffer(const std::shared_ptr<VKContext>* context, const void* data, size_t size);
+		~VKIndirectBuffer();
+
+		virtual bool IsReady() const override;
+		VkBuffer GetNativeBuffer() const;
+	};
 }
@@ -1,7 +1,18 @@
 #include "VKContext.hpp"
+#include "VKUploadManager.hpp"
+#include "VKFrameAllocator.hpp"
+#include "VKDescriptorAllocator.hpp"
+#include "VKBindlessHeap.hpp"
+#include "VKPipelineManifest.hpp"
+#include "VKShader.hpp"
+#include "VKBuffer.hpp"
 #include "Application.hpp"
+#include "Console.hpp"
+#include "FileHandler.hpp"
 #include <cassert>
+#include <cstring>
 #include <set>
+#include <algorithm>
 
 #ifdef RENDER_DEBUG_MODE
 const std::vector<const char*> SampleRender::VKContext::s_ValidationLayers =
@@ -37,47 +48,60 @@ bool SampleRender::VKContext::CheckValidationLayerSupport()
 
 #endif
 
-const std::vector<const char*> SampleRender::VKContext::deviceExtensions =
+static const bool s_HeadlessWindowClosing = false;
+//secondary buffer a worker thread is recording into, null outside worker ranges
+static thread_local VkCommandBuffer s_WorkerCommandBuffer = VK_NULL_HANDLE;
+//timestamp scopes open in the command buffer this thread is recording, they never span buffers
+static thread_local std::vector<uint32_t> s_OpenTimestamps;
+
+const uint32_t SampleRender::VKContext::s_MaxTimestampScopes = 32;
+const VkDeviceSize SampleRender::VKContext::s_StagingRingSize = 64 << 20;
+const VkDeviceSize SampleRender::VKContext::s_FrameAllocatorSize = 8 << 20;
+const uint32_t SampleRender::VKContext::s_PipelineCacheMagic = 0x504b5652;
+const uint32_t SampleRender::VKContext::s_PipelineCacheVersion = 1;
+const char* SampleRender::VKContext::s_ShaderObjectLayer = "VK_LAYER_KHRONOS_shader_object";
+
+SampleRender::VKContext::VKContext(const Window* windowHandle, const GraphicsSettings& settings) :
+    m_Settings(settings), m_FramesInFlight(settings.FramesInFlight)
 {
-    VK_KHR_SWAPCHAIN_EXTENSION_NAME
-};
-
-SampleRender::VKContext::VKContext(const Window* windowHandle, uint32_t framesInFlight) :
-    m_FramesInFlight(framesInFlight)
-{
-    m_ClearColor.float32[0] = 1.0f;
-    m_ClearColor.float32[1] = 76.0f/255.0f;
-    m_ClearColor.float32[2] = 48.0f/ 255.0f;
-    m_ClearColor.float32[3] = 1.0f;
-
     m_IsWindowClosing = windowHandle->TrackWindowClosing();
+    m_DeviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
 
     CreateInstance();
 #ifdef RENDER_DEBUG_MODE
     SetupDebugMessage();
 #endif
     CreateSurface(windowHandle);
-    SelectAdapter();
-    BufferizeUniformAttachment();
-    GetGPUName();
-    CreateDevice();
-    CreateViewportAndScissor(windowHandle->GetWidth(), windowHandle->GetHeight());
-    CreateSwapChain();
-    CreateImageView();
-    CreateRenderPass();
-    CreateDepthStencilView();
-    CreateFramebuffers();
-    CreateCommandPool();
-    CreateCommandBuffers();
-    CreateSyncObjects();
+    CreateCoreObjects(windowHandle->GetWidth(), windowHandle->GetHeight());
+}
+
+SampleRender::VKContext::VKContext(uint32_t width, uint32_t height, const GraphicsSettings& settings) :
+    m_Headless(true), m_Settings(settings), m_FramesInFlight(settings.FramesInFlight)
+{
+    m_IsWindowClosing = &s_HeadlessWindowClosing;
+
+    CreateInstance();
+#ifdef RENDER_DEBUG_MODE
+    SetupDebugMessage();
+#endif
+    CreateCoreObjects(width, height);
 }
 
 SampleRender::VKContext::~VKContext()
 {
     vkDeviceWaitIdle(m_Device);
-    for (size_t i = 0; i < m_FramesInFlight; i++)
-        vkDestroyFence(m_Device, m_InFlightFences[i], nullptr);
-    delete[] m_InFlightFences;
+    RetireWorkerCommandBuffers();
+    FlushDestructionQueue();
+    m_UploadManager.reset();
+    m_FrameAllocator.reset();
+    m_DescriptorAllocator.reset();
+    m_BindlessHeap.reset();
+    SavePipelineCache();
+    m_PipelineManifest->Save();
+    vkDestroyPipelineCache(m_Device, m_PipelineCache, nullptr);
+    CleanupTimestampQueries();
+    vkDestroySemaphore(m_Device, m_TimelineSemaphore, nullptr);
+    delete[] m_FrameTimelineValues;
     
     for (size_t i = 0; i < m_FramesInFlight; i++)
         vkDestroySemaphore(m_Device, m_ImageAvailableSemaphores[i], nullptr);
@@ -89,14 +113,22 @@ SampleRender::VKContext::~VKContext()
     
     delete[] m_CommandBuffers;
     
-    vkDestroyCommandPool(m_Device, m_CommandPool, nullptr);
+    for (size_t i = 0; i < m_FramesInFlight; i++)
+        vkDestroyCommandPool(m_Device, m_CommandPools[i], nullptr);
+    delete[] m_CommandPools;
+    vkDestroyCommandPool(m_Device, m_OneShotCommandPool, nullptr);
     CleanupFramebuffers();
     CleanupDepthStencilView();
     vkDestroyRenderPass(m_Device, m_RenderPass, nullptr);
     CleanupImageView();
-    CleanupSwapChain();
+    if (m_Headless)
+        CleanupOffscreenTargets();
+    else
+        CleanupSwapChain();
+    m_MemoryAllocator.reset();
     vkDestroyDevice(m_Device, nullptr);
-    vkDestroySurfaceKHR(m_Instance, m_Surface, nullptr);
+    if (!m_Headless)
+        vkDestroySurfaceKHR(m_Instance, m_Surface, nullptr);
 #ifdef RENDER_DEBUG_MODE
     DestroyDebugUtilsMessengerEXT(m_Instance, m_DebugMessenger, nullptr);
 #endif
@@ -122,23 +154,52 @@ uint32_t SampleRender::VKContext::GetSmallBufferAttachment() const
     return 4;
 }
 
-void SampleRender::VKContext::ReceiveCommands()
+void SampleRender::VKContext::PaceFrame()
 {
-    vkWaitForFences(m_Device, 1, &m_InFlightFences[m_CurrentBufferIndex], VK_TRUE, UINT64_MAX);
+    if (!m_LowLatency || (m_PresentId == 0))
+        return;
 
-    VkResult result = vkAcquireNextImageKHR(m_Device, m_SwapChain, UINT64_MAX, m_ImageAvailableSemaphores[m_CurrentBufferIndex], VK_NULL_HANDLE, &m_CurrentImageIndex);
+    //bounded, a minimized or occluded window may never show the image
+    VkResult result = m_WaitForPresent(m_Device, m_SwapChain, m_PresentId, 100000000);
+    if ((result != VK_SUCCESS) && (result != VK_TIMEOUT) && (result != VK_ERROR_OUT_OF_DATE_KHR) && (result != VK_SUBOPTIMAL_KHR))
+        throw std::runtime_error("failed to wait for present!");
+}
 
-    if ((result == VK_ERROR_OUT_OF_DATE_KHR) && !(*m_IsWindowClosing)) {
-        vkDeviceWaitIdle(m_Device);
-        RecreateSwapChain();
-        return;
+void SampleRender::VKContext::ReceiveCommands()
+{
+    WaitTimelineValue(m_FrameTimelineValues[m_CurrentBufferIndex]);
+    m_FrameAllocator->BeginFrame(m_CurrentBufferIndex);
+    m_DescriptorAllocator->BeginFrame(m_CurrentBufferIndex);
+    ReleaseCompletedResources();
+    CompactMemory();
+    ReadTimestampQueries();
+
+    if (m_Headless)
+    {
+        //the offscreen ring has one target per frame in flight, already released by the fence above
+        m_CurrentImageIndex = m_CurrentBufferIndex;
     }
-    else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
-        throw std::runtime_error("failed to acquire swap chain image!");
+    else
+    {
+        VkResult result = vkAcquireNextImageKHR(m_Device, m_SwapChain, UINT64_MAX, m_ImageAvailableSemaphores[m_CurrentBufferIndex], VK_NULL_HANDLE, &m_CurrentImageIndex);
+
+        //a failed acquire leaves the semaphore unsignaled, so it can be reused right away
+        while ((result == VK_ERROR_OUT_OF_DATE_KHR) && !(*m_IsWindowClosing)) {
+            RecreateSwapChain();
+            result = vkAcquireNextImageKHR(m_Device, m_SwapChain, UINT64_MAX, m_ImageAvailableSemaphores[m_CurrentBufferIndex], VK_NULL_HANDLE, &m_CurrentImageIndex);
+        }
+
+        if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+            throw std::runtime_error("failed to acquire swap chain image!");
+        }
     }
 
-    vkResetFences(m_Device, 1, &m_InFlightFences[m_CurrentBufferIndex]);
-    vkResetCommandBuffer(m_CommandBuffers[m_CurrentBufferIndex],  0);
+    vkResetCommandPool(m_Device, m_CommandPools[m_CurrentBufferIndex], 0);
+    for (uint32_t i = 0; i < m_RecordingWorkers; i++)
+    {
+        vkResetCommandPool(m_Device, m_WorkerCommandPools[m_CurrentBufferIndex * m_RecordingWorkers + i], 0);
+        m_WorkerRecorded[i] = 0;
+    }
 
     VkCommandBufferBeginInfo beginInfo{};
     beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -147,6 +208,17 @@ void SampleRender::VKContext::ReceiveCommands()
         throw std::runtime_error("failed to begin recording command buffer!");
     }
 
+    if (m_TimestampsSupported)
+        vkCmdResetQueryPool(m_CommandBuffers[m_CurrentBufferIndex], m_TimestampQueryPools[m_CurrentBufferIndex], 0, s_MaxTimestampScopes * 2);
+
+    m_UploadWaitValue = m_UploadManager->RecordAcquireBarriers(m_CommandBuffers[m_CurrentBufferIndex]);
+
+    if (m_DynamicRendering)
+    {
+        BeginDynamicRendering();
+        return;
+    }
+
     VkRenderPassBeginInfo renderPassInfo{};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
     renderPassInfo.renderPass = m_RenderPass;
@@ -161,12 +233,31 @@ void SampleRender::VKContext::ReceiveCommands()
     renderPassInfo.clearValueCount = clearValues.size();
     renderPassInfo.pClearValues = clearValues.data();
 
-    vkCmdBeginRenderPass(m_CommandBuffers[m_CurrentBufferIndex], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    VkSubpassContents contents = (m_RecordingWorkers > 0) ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE;
+    vkCmdBeginRenderPass(m_CommandBuffers[m_CurrentBufferIndex], &renderPassInfo, contents);
 }
 
 void SampleRender::VKContext::DispatchCommands()
 {
-    vkCmdEndRenderPass(m_CommandBuffers[m_CurrentBufferIndex]);
+    //uploads queued up to here land before the frame on the same queue, or start streaming on the transfer one
+    uint64_t uploadValue = m_UploadManager->Flush();
+
+    while (!s_OpenTimestamps.empty())
+        EndGPUTimestamp();
+
+    std::vector<VkCommandBuffer> workerBuffers;
+    for (uint32_t i = 0; i < m_RecordingWorkers; i++)
+    {
+        if (m_WorkerRecorded[i])
+            workerBuffers.push_back(m_WorkerCommandBuffers[m_CurrentBufferIndex * m_RecordingWorkers + i]);
+    }
+    if (!workerBuffers.empty())
+        vkCmdExecuteCommands(m_CommandBuffers[m_CurrentBufferIndex], (uint32_t)workerBuffers.size(), workerBuffers.data());
+
+    if (m_DynamicRendering)
+        EndDynamicRendering();
+    else
+        vkCmdEndRenderPass(m_CommandBuffers[m_CurrentBufferIndex]);
 
     if (vkEndCommandBuffer(m_CommandBuffers[m_CurrentBufferIndex]) != VK_SUCCESS) {
         throw std::runtime_error("failed to record command buffer!");
@@ -175,26 +266,65 @@ void SampleRender::VKContext::DispatchCommands()
     VkSubmitInfo submitInfo{};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-    VkSemaphore waitSemaphores[] = { m_ImageAvailableSemaphores[m_CurrentBufferIndex] };
-    VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = waitSemaphores;
-    submitInfo.pWaitDstStageMask = waitStages;
+    std::lock_guard<std::mutex> lock(m_QueueMutex);
+    uint64_t frameValue = ++m_TimelineValue;
+
+    std::vector<VkSemaphore> waitSemaphores;
+    std::vector<VkPipelineStageFlags> waitStages;
+    std::vector<uint64_t> waitValues;
+    if (!m_Headless)
+    {
+        waitSemaphores.push_back(m_ImageAvailableSemaphores[m_CurrentBufferIndex]);
+        waitStages.push_back(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+        waitValues.push_back(0);
+    }
+    //pairs the release on the transfer queue with the acquire barriers recorded at the frame start
+    if (m_UploadWaitValue > 0)
+    {
+        waitSemaphores.push_back(m_UploadManager->GetUploadSemaphore());
+        waitStages.push_back(VK_PIPELINE_STAGE_TRANSFER_BIT);
+        waitValues.push_back(m_UploadWaitValue);
+    }
+    submitInfo.waitSemaphoreCount = (uint32_t)waitSemaphores.size();
+    submitInfo.pWaitSemaphores = waitSemaphores.data();
+    submitInfo.pWaitDstStageMask = waitStages.data();
 
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &m_CommandBuffers[m_CurrentBufferIndex];
 
-    VkSemaphore signalSemaphores[] = { m_RenderFinishedSemaphores[m_CurrentBufferIndex] };
-    submitInfo.signalSemaphoreCount = 1;
+    //the timeline goes first so headless submits can drop the binary one
+    VkSemaphore signalSemaphores[] = { m_TimelineSemaphore, m_RenderFinishedSemaphores[m_CurrentBufferIndex] };
+    uint64_t signalValues[] = { frameValue, 0 };
+    submitInfo.signalSemaphoreCount = m_Headless ? 1 : 2;
     submitInfo.pSignalSemaphores = signalSemaphores;
 
-    if (vkQueueSubmit(m_GraphicsQueue, 1, &submitInfo, m_InFlightFences[m_CurrentBufferIndex]) != VK_SUCCESS) {
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.waitSemaphoreValueCount = submitInfo.waitSemaphoreCount;
+    timelineInfo.pWaitSemaphoreValues = waitValues.data();
+    timelineInfo.signalSemaphoreValueCount = submitInfo.signalSemaphoreCount;
+    timelineInfo.pSignalSemaphoreValues = signalValues;
+    submitInfo.pNext = &timelineInfo;
+
+    if (vkQueueSubmit(m_GraphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
         throw std::runtime_error("failed to submit draw command buffer!");
     }
+    m_FrameTimelineValues[m_CurrentBufferIndex] = frameValue;
+
+    //a resource can outlive the frame while its copy is still running on the transfer queue
+    for (auto& destroyer : m_PendingDestruction)
+        m_DestructionQueue.push_back({ frameValue, uploadValue, destroyer });
+    m_PendingDestruction.clear();
 }
 
 void SampleRender::VKContext::Present()
 {
+    if (m_Headless)
+    {
+        m_CurrentBufferIndex = (m_CurrentBufferIndex + 1) % m_FramesInFlight;
+        return;
+    }
+
     VkSemaphore signalSemaphores[] = { m_RenderFinishedSemaphores[m_CurrentBufferIndex] };
 
     VkPresentInfoKHR presentInfo{};
@@ -209,10 +339,23 @@ void SampleRender::VKContext::Present()
 
     presentInfo.pImageIndices = &m_CurrentImageIndex;
 
-    VkResult result = vkQueuePresentKHR(m_PresentQueue, &presentInfo);
+    uint64_t presentId = m_PresentId + 1;
+    VkPresentIdKHR presentIdInfo{};
+    presentIdInfo.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+    presentIdInfo.swapchainCount = 1;
+    presentIdInfo.pPresentIds = &presentId;
+    if (m_LowLatency)
+        presentInfo.pNext = &presentIdInfo;
+
+    VkResult result;
+    {
+        //the present queue can be the graphics queue, which upload flushes submit to from pool threads
+        std::lock_guard<std::mutex> lock(m_QueueMutex);
+        result = vkQueuePresentKHR(m_PresentQueue, &presentInfo);
+    }
+    m_PresentId = presentId;
 
     if ((result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) && !(*m_IsWindowClosing)) {
-        vkDeviceWaitIdle(m_Device);
         RecreateSwapChain();
     }
     else if ((result != VK_SUCCESS) && !(*m_IsWindowClosing)) {
@@ -224,13 +367,69 @@ void SampleRender::VKContext::Present()
 
 void SampleRender::VKContext::StageViewportAndScissors()
 {
-    vkCmdSetViewport(m_CommandBuffers[m_CurrentBufferIndex], 0, 1, &m_Viewport);
-    vkCmdSetScissor(m_CommandBuffers[m_CurrentBufferIndex], 0, 1, &m_ScissorRect);
+    auto commandBuffer = GetCurrentCommandBuffer();
+    //shader objects have no viewport count of their own, it comes with the state
+    if (m_ShaderObject)
+    {
+        vkCmdSetViewportWithCount(commandBuffer, 1, &m_Viewport);
+        vkCmdSetScissorWithCount(commandBuffer, 1, &m_ScissorRect);
+        return;
+    }
+    vkCmdSetViewport(commandBuffer, 0, 1, &m_Viewport);
+    vkCmdSetScissor(commandBuffer, 0, 1, &m_ScissorRect);
 }
 
 void SampleRender::VKContext::Draw(uint32_t elements)
 {
-    vkCmdDrawIndexed(m_CommandBuffers[m_CurrentBufferIndex], elements, 1, 0, 0, 0);
+    vkCmdDrawIndexed(GetCurrentCommandBuffer(), elements, 1, 0, 0, 0);
+}
+
+void SampleRender::VKContext::DrawInstanced(uint32_t elements, uint32_t instances, uint32_t firstIndex, int32_t baseVertex, uint32_t firstInstance)
+{
+    vkCmdDrawIndexed(GetCurrentCommandBuffer(), elements, instances, firstIndex, baseVertex, firstInstance);
+}
+
+void SampleRender::VKContext::DrawIndexedIndirect(const IndirectBuffer* arguments, uint32_t drawCount, uint64_t argumentOffset)
+{
+    auto commandBuffer = GetCurrentCommandBuffer();
+    VkBuffer buffer = ((const VKIndirectBuffer*)arguments)->GetNativeBuffer();
+    const uint32_t stride = sizeof(IndirectDrawArguments);
+
+    if (m_MultiDrawIndirect)
+    {
+        vkCmdDrawIndexedIndirect(commandBuffer, buffer, argumentOffset, drawCount, stride);
+        return;
+    }
+    //without multiDrawIndirect every record needs its own call
+    for (uint32_t i = 0; i < drawCount; i++)
+        vkCmdDrawIndexedIndirect(commandBuffer, buffer, argumentOffset + (uint64_t)i * stride, 1, stride);
+}
+
+void SampleRender::VKContext::DrawIndexedIndirectCount(const IndirectBuffer* arguments, const IndirectBuffer* countBuffer, uint32_t maxDraws, uint64_t argumentOffset, uint64_t countOffset)
+{
+    if (!m_DrawIndirectCount)
+        throw std::runtime_error("drawIndirectCount is not supported by this device!");
+
+    VkBuffer buffer = ((const VKIndirectBuffer*)arguments)->GetNativeBuffer();
+    VkBuffer count = ((const VKIndirectBuffer*)countBuffer)->GetNativeBuffer();
+    vkCmdDrawIndexedIndirectCount(GetCurrentCommandBuffer(), buffer, argumentOffset, count, countOffset, maxDraws, sizeof(IndirectDrawArguments));
+}
+
+void SampleRender::VKContext::StageDynamicVertices(const void* data, size_t size, uint32_t stride, uint32_t bindingSlot)
+{
+    VkDeviceSize offset;
+    memcpy(m_FrameAllocator->Allocate(size, offset), data, size);
+    VkBuffer buffer = m_FrameAllocator->GetBuffer();
+    vkCmdBindVertexBuffers(GetCurrentCommandBuffer(), bindingSlot, 1, &buffer, &offset);
+}
+
+void SampleRender::VKContext::StageDynamicIndices(const void* data, uint32_t count, IndexFormat format)
+{
+    VkDeviceSize offset;
+    size_t size = (size_t)IndexFormatSize(format) * count;
+    memcpy(m_FrameAllocator->Allocate(size, offset), data, size);
+    VkIndexType indexType = (format == IndexFormat::Uint16) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+    vkCmdBindIndexBuffer(GetCurrentCommandBuffer(), m_FrameAllocator->GetBuffer(), offset, indexType);
 }
 
 const std::string SampleRender::VKContext::GetGPUName()
@@ -243,15 +442,332 @@ const std::string SampleRender::VKContext::GetGPUName()
 
 void SampleRender::VKContext::WindowResize(uint32_t width, uint32_t height)
 {
-    vkDeviceWaitIdle(m_Device);
     CreateViewportAndScissor(width, height);
 
     RecreateSwapChain();
 }
 
-VkCommandPool SampleRender::VKContext::GetCommandPool() const
+uint32_t SampleRender::VKContext::SetRecordingWorkers(uint32_t workers)
+{
+    if (workers == m_RecordingWorkers)
+        return m_RecordingWorkers;
+
+    RetireWorkerCommandBuffers();
+    m_RecordingWorkers = workers;
+    CreateWorkerCommandBuffers();
+    return m_RecordingWorkers;
+}
+
+void SampleRender::VKContext::BeginWorkerCommands(uint32_t worker)
+{
+    assert(worker < m_RecordingWorkers);
+    VkCommandBuffer commandBuffer = m_WorkerCommandBuffers[m_CurrentBufferIndex * m_RecordingWorkers + worker];
+
+    VkCommandBufferInheritanceRenderingInfo renderingInfo{};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachmentFormats = &m_SwapChainImageFormat;
+    renderingInfo.depthAttachmentFormat = m_DepthFormat;
+    renderingInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkCommandBufferInheritanceInfo inheritanceInfo{};
+    inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    if (m_DynamicRendering)
+        inheritanceInfo.pNext = &renderingInfo;
+    else
+    {
+        inheritanceInfo.renderPass = m_RenderPass;
+        inheritanceInfo.subpass = 0;
+        inheritanceInfo.framebuffer = m_SwapChainFramebuffers[m_CurrentImageIndex];
+    }
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin recording worker command buffer!");
+    }
+    s_WorkerCommandBuffer = commandBuffer;
+}
+
+void SampleRender::VKContext::EndWorkerCommands(uint32_t worker)
 {
-    return m_CommandPool;
+    assert(worker < m_RecordingWorkers);
+    while (!s_OpenTimestamps.empty())
+        EndGPUTimestamp();
+    if (vkEndCommandBuffer(m_WorkerCommandBuffers[m_CurrentBufferIndex * m_RecordingWorkers + worker]) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record worker command buffer!");
+    }
+    m_WorkerRecorded[worker] = 1;
+    s_WorkerCommandBuffer = VK_NULL_HANDLE;
+}
+
+void SampleRender::VKContext::BeginGPUTimestamp(std::string_view name)
+{
+    //with workers enabled the primary buffer only accepts vkCmdExecuteCommands inside the pass
+    bool canRecord = (m_RecordingWorkers == 0) || (s_WorkerCommandBuffer != VK_NULL_HANDLE);
+    if (!m_TimestampsSupported || !canRecord)
+    {
+        s_OpenTimestamps.push_back(UINT32_MAX);
+        return;
+    }
+
+    uint32_t scope;
+    {
+        //workers reserve their query pairs concurrently
+        std::lock_guard<std::mutex> lock(m_TimestampMutex);
+        auto& names = m_TimestampNames[m_CurrentBufferIndex];
+        scope = (names.size() < s_MaxTimestampScopes) ? (uint32_t)names.size() : UINT32_MAX;
+        if (scope != UINT32_MAX)
+            names.push_back(std::string(name));
+    }
+    s_OpenTimestamps.push_back(scope);
+    if (scope == UINT32_MAX)
+        return;
+    vkCmdWriteTimestamp(GetCurrentCommandBuffer(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_TimestampQueryPools[m_CurrentBufferIndex], scope * 2);
+}
+
+void SampleRender::VKContext::EndGPUTimestamp()
+{
+    if (s_OpenTimestamps.empty())
+        return;
+
+    uint32_t scope = s_OpenTimestamps.back();
+    s_OpenTimestamps.pop_back();
+    if (scope == UINT32_MAX)
+        return;
+
+    vkCmdWriteTimestamp(GetCurrentCommandBuffer(), VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_TimestampQueryPools[m_CurrentBufferIndex], scope * 2 + 1);
+}
+
+const std::vector<SampleRender::GPUTimestampScope>& SampleRender::VKContext::GetGPUTimestamps() const
+{
+    return m_GPUTimestamps;
+}
+
+void SampleRender::VKContext::WarmUpPipelines(ThreadPool* pool)
+{
+    const Json::Value& entries = m_PipelineManifest->GetEntries();
+    //shader objects are compiled per stage on creation, there is nothing to warm up
+    if (entries.empty() || m_ShaderObject)
+        return;
+
+    Console::CoreLog("Warming up {} pipelines from {}", entries.size(), m_Settings.PipelineManifestPath);
+    //the pool drains its queue before the context goes away, nobody reads the futures so failures are logged here
+    for (const auto& entry : entries)
+    {
+        pool->Enqueue([this, entry]()
+        {
+            try
+            {
+                VKShader::WarmUpPipeline(this, entry);
+            }
+            catch (const std::exception& e)
+            {
+                Console::CoreError("Pipeline warm up failed: {}", e.what());
+            }
+        });
+    }
+}
+
+void SampleRender::VKContext::EnqueueDestruction(std::function<void()> destroyer)
+{
+    //the frame being recorded (or the next one) is the last that could have referenced the resource
+    m_PendingDestruction.push_back(destroyer);
+}
+
+uint64_t SampleRender::VKContext::SubmitCommandBuffer(VkCommandBuffer commandBuffer)
+{
+    std::lock_guard<std::mutex> lock(m_QueueMutex);
+    uint64_t value = ++m_TimelineValue;
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.signalSemaphoreValueCount = 1;
+    timelineInfo.pSignalSemaphoreValues = &value;
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &m_TimelineSemaphore;
+
+    if (vkQueueSubmit(m_GraphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit command buffer!");
+    }
+    return value;
+}
+
+VkCommandBuffer SampleRender::VKContext::BeginOneShotCommands()
+{
+    //the pool is externally synchronized, recording keeps it locked until SubmitOneShotCommands
+    m_OneShotMutex.lock();
+
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    uint64_t completedValue = GetCompletedTimelineValue();
+    while (!m_PendingOneShotBuffers.empty() && (m_PendingOneShotBuffers.front().first <= completedValue))
+    {
+        m_FreeOneShotBuffers.push_back(m_PendingOneShotBuffers.front().second);
+        m_PendingOneShotBuffers.pop_front();
+    }
+
+    if (m_FreeOneShotBuffers.empty())
+    {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = m_OneShotCommandPool;
+        allocInfo.commandBufferCount = 1;
+
+        VkResult vkr = vkAllocateCommandBuffers(m_Device, &allocInfo, &commandBuffer);
+        assert(vkr == VK_SUCCESS);
+    }
+    else
+    {
+        commandBuffer = m_FreeOneShotBuffers.back();
+        m_FreeOneShotBuffers.pop_back();
+    }
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    //begin implicitly resets a recycled buffer
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        m_OneShotMutex.unlock();
+        throw std::runtime_error("failed to begin one-shot command buffer!");
+    }
+    return commandBuffer;
+}
+
+uint64_t SampleRender::VKContext::SubmitOneShotCommands(VkCommandBuffer commandBuffer)
+{
+    //taken by BeginOneShotCommands
+    std::lock_guard<std::mutex> lock(m_OneShotMutex, std::adopt_lock);
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record one-shot command buffer!");
+    }
+
+    uint64_t value = SubmitCommandBuffer(commandBuffer);
+    m_PendingOneShotBuffers.push_back(std::make_pair(value, commandBuffer));
+    return value;
+}
+
+void SampleRender::VKContext::WaitTimelineValue(uint64_t value) const
+{
+    if (value == 0)
+        return;
+
+    VkSemaphoreWaitInfo waitInfo{};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &m_TimelineSemaphore;
+    waitInfo.pValues = &value;
+    vkWaitSemaphores(m_Device, &waitInfo, UINT64_MAX);
+}
+
+uint64_t SampleRender::VKContext::GetCompletedTimelineValue() const
+{
+    uint64_t value = 0;
+    vkGetSemaphoreCounterValue(m_Device, m_TimelineSemaphore, &value);
+    return value;
+}
+
+SampleRender::GPUMemoryStatistics SampleRender::VKContext::GetMemoryStatistics()
+{
+    return m_MemoryAllocator->GetStatistics();
+}
+
+SampleRender::VKMemoryAllocator* SampleRender::VKContext::GetMemoryAllocator() const
+{
+    return m_MemoryAllocator.get();
+}
+
+SampleRender::VKFrameAllocator* SampleRender::VKContext::GetFrameAllocator() const
+{
+    return m_FrameAllocator.get();
+}
+
+SampleRender::VKDescriptorAllocator* SampleRender::VKContext::GetDescriptorAllocator() const
+{
+    return m_DescriptorAllocator.get();
+}
+
+SampleRender::VKBindlessHeap* SampleRender::VKContext::GetBindlessHeap() const
+{
+    return m_BindlessHeap.get();
+}
+
+SampleRender::VKUploadManager* SampleRender::VKContext::GetUploadManager() const
+{
+    return m_UploadManager.get();
+}
+
+VkPipelineCache SampleRender::VKContext::GetPipelineCache() const
+{
+    return m_PipelineCache;
+}
+
+bool SampleRender::VKContext::IsCreationFeedbackEnabled() const
+{
+    return m_CreationFeedback;
+}
+
+SampleRender::VKPipelineManifest* SampleRender::VKContext::GetPipelineManifest() const
+{
+    return m_PipelineManifest.get();
+}
+
+bool SampleRender::VKContext::IsShaderObjectEnabled() const
+{
+    return m_ShaderObject;
+}
+
+bool SampleRender::VKContext::IsDynamicRenderingEnabled() const
+{
+    return m_DynamicRendering;
+}
+
+VkPipelineRenderingCreateInfo SampleRender::VKContext::GetPipelineRenderingInfo() const
+{
+    VkPipelineRenderingCreateInfo renderingInfo{};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachmentFormats = &m_SwapChainImageFormat;
+    renderingInfo.depthAttachmentFormat = m_DepthFormat;
+    return renderingInfo;
+}
+
+const SampleRender::ShaderObjectDispatch& SampleRender::VKContext::GetShaderObjectDispatch() const
+{
+    return m_ShaderObjectDispatch;
+}
+
+bool SampleRender::VKContext::IsHostImageCopyEnabled() const
+{
+    return m_HostImageCopy;
+}
+
+const SampleRender::HostImageCopyDispatch& SampleRender::VKContext::GetHostImageCopyDispatch() const
+{
+    return m_HostImageCopyDispatch;
+}
+
+void SampleRender::VKContext::ReportPipelineCreation(std::string_view name, const VkPipelineCreationFeedbackEXT& feedback)
+{
+    if (!(feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT_EXT))
+        return;
+
+    bool hit = (feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT_EXT) != 0;
+    if (hit)
+        m_PipelineCacheHits++;
+    else
+        m_PipelineCacheMisses++;
+    Console::CoreLog("Pipeline {}: cache {}, {:.3f} ms", name, hit ? "hit" : "miss", feedback.duration / 1000000.0);
 }
 
 VkQueue SampleRender::VKContext::GetGraphicsQueue() const
@@ -259,6 +775,11 @@ VkQueue SampleRender::VKContext::GetGraphicsQueue() const
     return m_GraphicsQueue;
 }
 
+VkQueue SampleRender::VKContext::GetTransferQueue() const
+{
+    return m_TransferQueue;
+}
+
 VkPhysicalDevice SampleRender::VKContext::GetAdapter() const
 {
     return m_Adapter;
@@ -276,6 +797,8 @@ VkRenderPass SampleRender::VKContext::GetRenderPass() const
 
 VkCommandBuffer SampleRender::VKContext::GetCurrentCommandBuffer() const
 {
+    if (s_WorkerCommandBuffer != VK_NULL_HANDLE)
+        return s_WorkerCommandBuffer;
     return m_CommandBuffers[m_CurrentBufferIndex];
 }
 
@@ -284,6 +807,55 @@ VkSurfaceKHR SampleRender::VKContext::GetSurface() const
     return m_Surface;
 }
 
+SampleRender::QueueFamilyIndices SampleRender::VKContext::GetQueueFamilies() const
+{
+    return m_QueueFamilies;
+}
+
+bool SampleRender::VKContext::IsHeadless() const
+{
+    return m_Headless;
+}
+
+void SampleRender::VKContext::CreateCoreObjects(uint32_t width, uint32_t height)
+{
+    m_ClearColor.float32[0] = 1.0f;
+    m_ClearColor.float32[1] = 76.0f/255.0f;
+    m_ClearColor.float32[2] = 48.0f/ 255.0f;
+    m_ClearColor.float32[3] = 1.0f;
+
+    SelectAdapter();
+    SelectOptionalFeatures();
+    m_QueueFamilies = FindQueueFamilies(m_Adapter);
+    m_DepthFormat = FindDepthFormat();
+    BufferizeUniformAttachment();
+    GetGPUName();
+    CreateDevice();
+    m_MemoryAllocator.reset(new VKMemoryAllocator(this));
+    CreatePipelineCache();
+    CreateViewportAndScissor(width, height);
+    if (m_Headless)
+        CreateOffscreenTargets();
+    else
+        CreateSwapChain();
+    CreateImageView();
+    //dynamic rendering begins directly on the image views
+    if (!m_DynamicRendering)
+        CreateRenderPass();
+    CreateDepthStencilView();
+    if (!m_DynamicRendering)
+        CreateFramebuffers();
+    CreateCommandPools();
+    CreateCommandBuffers();
+    CreateSyncObjects();
+    CreateTimestampQueries();
+    m_UploadManager.reset(new VKUploadManager(this, s_StagingRingSize));
+    m_FrameAllocator.reset(new VKFrameAllocator(this, s_FrameAllocatorSize, m_FramesInFlight));
+    m_DescriptorAllocator.reset(new VKDescriptorAllocator(this, m_FramesInFlight));
+    if (m_Bindless)
+        m_BindlessHeap.reset(new VKBindlessHeap(this));
+}
+
 void SampleRender::VKContext::CreateInstance()
 {
     VkResult vkr;
@@ -303,11 +875,14 @@ void SampleRender::VKContext::CreateInstance()
     createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
     createInfo.pApplicationInfo = &appInfo;
 
-    m_InstanceExtensions.push_back("VK_KHR_surface");
+    if (!m_Headless)
+    {
+        m_InstanceExtensions.push_back("VK_KHR_surface");
 
 #ifdef RENDER_USES_WINDOWS
-    m_InstanceExtensions.push_back(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
+        m_InstanceExtensions.push_back(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
 #endif
+    }
 
 #ifdef RENDER_DEBUG_MODE
     m_InstanceExtensions.push_back("VK_EXT_debug_utils");
@@ -316,26 +891,45 @@ void SampleRender::VKContext::CreateInstance()
     createInfo.enabledExtensionCount = static_cast<uint32_t>(m_InstanceExtensions.size());
     createInfo.ppEnabledExtensionNames = m_InstanceExtensions.data();
 
+#ifdef RENDER_DEBUG_MODE
+    m_InstanceLayers.insert(m_InstanceLayers.end(), s_ValidationLayers.begin(), s_ValidationLayers.end());
+#endif
+    //emulates VK_EXT_shader_object where the driver lacks it, passes through otherwise
+    if (m_Settings.ShaderObjects && IsInstanceLayerAvailable(s_ShaderObjectLayer))
+        m_InstanceLayers.push_back(s_ShaderObjectLayer);
+
+    createInfo.enabledLayerCount = static_cast<uint32_t>(m_InstanceLayers.size());
+    createInfo.ppEnabledLayerNames = m_InstanceLayers.data();
+
 #ifdef RENDER_DEBUG_MODE
     
 
     VkDebugUtilsMessengerCreateInfoEXT debugCreateInfo{};
 
-    createInfo.enabledLayerCount = static_cast<uint32_t>(s_ValidationLayers.size());
-    createInfo.ppEnabledLayerNames = s_ValidationLayers.data();
-
     PopulateDebugMessengerCreateInfo(debugCreateInfo);
     createInfo.pNext = (VkDebugUtilsMessengerCreateInfoEXT*)&debugCreateInfo;
 #else
 
-    createInfo.enabledLayerCount = 0;
-
     createInfo.pNext = nullptr;
 #endif
     vkr = vkCreateInstance(&createInfo, nullptr, &m_Instance);
     assert(vkr == VK_SUCCESS);
 }
 
+bool SampleRender::VKContext::IsInstanceLayerAvailable(const char* layerName)
+{
+    uint32_t layerCount;
+    vkEnumerateInstanceLayerProperties(&layerCount, nullptr);
+
+    std::vector<VkLayerProperties> availableLayers(layerCount);
+    vkEnumerateInstanceLayerProperties(&layerCount, availableLayers.data());
+
+    for (const auto& layerProperties : availableLayers)
+        if (strcmp(layerName, layerProperties.layerName) == 0)
+            return true;
+    return false;
+}
+
 void SampleRender::VKContext::CreateSurface(const Window* windowHandle)
 {
     VkResult vkr;
@@ -396,14 +990,21 @@ bool SampleRender::VKContext::IsDeviceSuitable(VkPhysicalDevice adapter)
 
     bool extensionsSupported = CheckDeviceExtensionSupport(adapter);
 
-    bool swapChainAdequate = false;
-    if (extensionsSupported)
+    bool swapChainAdequate = m_Headless;
+    if (extensionsSupported && !m_Headless)
     {
         SwapChainSupportDetails swapChainSupport = QuerySwapChainSupport(adapter);
         swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
     }
 
-    return indices.isComplete() && extensionsSupported && swapChainAdequate;
+    VkPhysicalDeviceVulkan12Features vulkan12Features{};
+    vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    VkPhysicalDeviceFeatures2 features{};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &vulkan12Features;
+    vkGetPhysicalDeviceFeatures2(adapter, &features);
+
+    return indices.isComplete() && extensionsSupported && swapChainAdequate && vulkan12Features.timelineSemaphore;
 }
 
 SampleRender::QueueFamilyIndices SampleRender::VKContext::FindQueueFamilies(VkPhysicalDevice adapter)
@@ -419,15 +1020,22 @@ SampleRender::QueueFamilyIndices SampleRender::VKContext::FindQueueFamilies(VkPh
     int i = 0;
     for (const auto& queueFamily : queueFamilies)
     {
-        if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
-            indices.graphicsFamily = i;
-        VkBool32 presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(adapter, i, m_Surface, &presentSupport);
-        if (presentSupport)
-            indices.presentFamily = i;
+        if (!indices.isComplete())
+        {
+            if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+                indices.graphicsFamily = i;
+            //nothing is presented when headless, the graphics queue stands in for the present one
+            VkBool32 presentSupport = m_Headless && (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT);
+            if (!m_Headless)
+                vkGetPhysicalDeviceSurfaceSupportKHR(adapter, i, m_Surface, &presentSupport);
+            if (presentSupport)
+                indices.presentFamily = i;
+        }
 
-        if (indices.isComplete())
-            break;
+        //a family without graphics or compute is the dedicated copy engine
+        bool transferOnly = (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queueFamily.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT));
+        if (transferOnly && !indices.transferFamily.has_value())
+            indices.transferFamily = i;
         i++;
     }
 
@@ -442,7 +1050,7 @@ bool SampleRender::VKContext::CheckDeviceExtensionSupport(VkPhysicalDevice adapt
     std::vector<VkExtensionProperties> availableExtensions(extensionCount);
     vkEnumerateDeviceExtensionProperties(adapter, nullptr, &extensionCount, availableExtensions.data());
 
-    std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
+    std::set<std::string> requiredExtensions(m_DeviceExtensions.begin(), m_DeviceExtensions.end());
 
     for (const auto& extension : availableExtensions) {
         requiredExtensions.erase(extension.extensionName);
@@ -476,6 +1084,175 @@ SampleRender::SwapChainSupportDetails SampleRender::VKContext::QuerySwapChainSup
     return details;
 }
 
+void SampleRender::VKContext::SelectOptionalFeatures()
+{
+    if (m_Settings.LowLatency && !m_Headless)
+    {
+        VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+        presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+        VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+        presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+        presentIdFeatures.pNext = &presentWaitFeatures;
+        VkPhysicalDeviceFeatures2 features{};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features.pNext = &presentIdFeatures;
+
+        bool extensionsAvailable = IsDeviceExtensionAvailable(VK_KHR_PRESENT_ID_EXTENSION_NAME) && IsDeviceExtensionAvailable(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+        if (extensionsAvailable)
+            vkGetPhysicalDeviceFeatures2(m_Adapter, &features);
+
+        m_LowLatency = extensionsAvailable && presentIdFeatures.presentId && presentWaitFeatures.presentWait;
+        if (m_LowLatency)
+        {
+            m_DeviceExtensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+            m_DeviceExtensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+        }
+        else
+            Console::CoreWarn("VK_KHR_present_wait is not supported, low latency mode disabled");
+    }
+
+    {
+        VkPhysicalDeviceVulkan12Features vulkan12Features{};
+        vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        VkPhysicalDeviceFeatures2 features{};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features.pNext = &vulkan12Features;
+        vkGetPhysicalDeviceFeatures2(m_Adapter, &features);
+
+        m_MultiDrawIndirect = features.features.multiDrawIndirect;
+        m_DrawIndirectFirstInstance = features.features.drawIndirectFirstInstance;
+        m_DrawIndirectCount = vulkan12Features.drawIndirectCount;
+
+        //descriptor indexing is core since 1.2, the features are queried from the same struct
+        if (m_Settings.BindlessTextures)
+        {
+            m_Bindless = vulkan12Features.descriptorIndexing && vulkan12Features.runtimeDescriptorArray &&
+                vulkan12Features.shaderSampledImageArrayNonUniformIndexing && vulkan12Features.descriptorBindingPartiallyBound &&
+                vulkan12Features.descriptorBindingSampledImageUpdateAfterBind && vulkan12Features.descriptorBindingUpdateUnusedWhilePending;
+            if (!m_Bindless)
+                Console::CoreWarn("Descriptor indexing is not supported, bindless textures disabled");
+        }
+    }
+
+    m_CreationFeedback = IsDeviceExtensionAvailable(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME);
+    if (m_CreationFeedback)
+        m_DeviceExtensions.push_back(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME);
+
+    bool dynamicRenderingSupported = false;
+    if (m_Settings.DynamicRendering || m_Settings.ShaderObjects)
+    {
+        VkPhysicalDeviceVulkan13Features vulkan13Features{};
+        vulkan13Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+        VkPhysicalDeviceFeatures2 features{};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features.pNext = &vulkan13Features;
+        vkGetPhysicalDeviceFeatures2(m_Adapter, &features);
+
+        dynamicRenderingSupported = vulkan13Features.dynamicRendering;
+        if (!dynamicRenderingSupported)
+            Console::CoreWarn("Dynamic rendering is not supported, using render passes");
+    }
+
+    if (m_Settings.ShaderObjects && dynamicRenderingSupported)
+    {
+        VkPhysicalDeviceShaderObjectFeaturesEXT shaderObjectFeatures{};
+        shaderObjectFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_OBJECT_FEATURES_EXT;
+        VkPhysicalDeviceFeatures2 features{};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features.pNext = &shaderObjectFeatures;
+
+        bool extensionAvailable = IsDeviceExtensionAvailable(VK_EXT_SHADER_OBJECT_EXTENSION_NAME);
+        if (extensionAvailable)
+            vkGetPhysicalDeviceFeatures2(m_Adapter, &features);
+
+        m_ShaderObject = extensionAvailable && shaderObjectFeatures.shaderObject;
+        if (m_ShaderObject)
+            m_DeviceExtensions.push_back(VK_EXT_SHADER_OBJECT_EXTENSION_NAME);
+        else
+            Console::CoreWarn("VK_EXT_shader_object is not supported, using baked pipelines");
+    }
+    //shader objects have no render pass to be compiled against
+    m_DynamicRendering = dynamicRenderingSupported && (m_Settings.DynamicRendering || m_ShaderObject);
+
+    if (IsDeviceExtensionAvailable(VK_EXT_HOST_IMAGE_COPY_EXTENSION_NAME))
+    {
+        VkPhysicalDeviceHostImageCopyFeaturesEXT hostImageCopyFeatures{};
+        hostImageCopyFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_FEATURES_EXT;
+        VkPhysicalDeviceFeatures2 features{};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features.pNext = &hostImageCopyFeatures;
+        vkGetPhysicalDeviceFeatures2(m_Adapter, &features);
+
+        //textures are sampled in SHADER_READ_ONLY_OPTIMAL, the host must be able to copy straight into it
+        VkPhysicalDeviceHostImageCopyPropertiesEXT hostImageCopyProperties{};
+        hostImageCopyProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_PROPERTIES_EXT;
+        VkPhysicalDeviceProperties2 properties{};
+        properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties.pNext = &hostImageCopyProperties;
+        vkGetPhysicalDeviceProperties2(m_Adapter, &properties);
+        std::vector<VkImageLayout> copyDstLayouts(hostImageCopyProperties.copyDstLayoutCount);
+        hostImageCopyProperties.pCopyDstLayouts = copyDstLayouts.data();
+        vkGetPhysicalDeviceProperties2(m_Adapter, &properties);
+        bool readOnlyDestination = std::find(copyDstLayouts.begin(), copyDstLayouts.end(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) != copyDstLayouts.end();
+
+        VkFormatProperties3 formatProperties3{};
+        formatProperties3.sType = VK_STRUCTURE_TYPE_FORMAT_PROPERTIES_3;
+        VkFormatProperties2 formatProperties{};
+        formatProperties.sType = VK_STRUCTURE_TYPE_FORMAT_PROPERTIES_2;
+        formatProperties.pNext = &formatProperties3;
+        vkGetPhysicalDeviceFormatProperties2(m_Adapter, VK_FORMAT_R8G8B8A8_UNORM, &formatProperties);
+        bool formatSupported = (formatProperties3.optimalTilingFeatures & VK_FORMAT_FEATURE_2_HOST_IMAGE_TRANSFER_BIT_EXT) != 0;
+
+        //the host transfer usage must not cost GPU side compression
+        VkHostImageCopyDevicePerformanceQueryEXT performanceQuery{};
+        performanceQuery.sType = VK_STRUCTURE_TYPE_HOST_IMAGE_COPY_DEVICE_PERFORMANCE_QUERY_EXT;
+        VkImageFormatProperties2 imageFormatProperties{};
+        imageFormatProperties.sType = VK_STRUCTURE_TYPE_IMAGE_FORMAT_PROPERTIES_2;
+        imageFormatProperties.pNext = &performanceQuery;
+        VkPhysicalDeviceImageFormatInfo2 imageFormatInfo{};
+        imageFormatInfo.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_FORMAT_INFO_2;
+        imageFormatInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+        imageFormatInfo.type = VK_IMAGE_TYPE_2D;
+        imageFormatInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageFormatInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT;
+        bool optimalAccess = formatSupported && (vkGetPhysicalDeviceImageFormatProperties2(m_Adapter, &imageFormatInfo, &imageFormatProperties) == VK_SUCCESS) && performanceQuery.optimalDeviceAccess;
+
+        m_HostImageCopy = hostImageCopyFeatures.hostImageCopy && readOnlyDestination && optimalAccess;
+        if (m_HostImageCopy)
+            m_DeviceExtensions.push_back(VK_EXT_HOST_IMAGE_COPY_EXTENSION_NAME);
+    }
+}
+
+bool SampleRender::VKContext::IsDeviceExtensionAvailable(const char* extensionName)
+{
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(m_Adapter, nullptr, &extensionCount, nullptr);
+
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(m_Adapter, nullptr, &extensionCount, availableExtensions.data());
+
+    for (const auto& extension : availableExtensions) {
+        if (strcmp(extensionName, extension.extensionName) == 0)
+            return true;
+    }
+    return false;
+}
+
+VkFormat SampleRender::VKContext::FindDepthFormat()
+{
+    //software ICDs like lavapipe do not always expose D24S8
+    const VkFormat candidates[] = { VK_FORMAT_D24_UNORM_S8_UINT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D32_SFLOAT };
+    for (VkFormat format : candidates) {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(m_Adapter, format, &properties);
+        if (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT)
+            return format;
+    }
+
+    assert(false);
+    return VK_FORMAT_UNDEFINED;
+}
+
 void SampleRender::VKContext::BufferizeUniformAttachment()
 {
     VkPhysicalDeviceProperties deviceProperties;
@@ -486,10 +1263,12 @@ void SampleRender::VKContext::BufferizeUniformAttachment()
 void SampleRender::VKContext::CreateDevice()
 {
     VkResult vkr;
-    QueueFamilyIndices indices = FindQueueFamilies(m_Adapter);
+    QueueFamilyIndices indices = m_QueueFamilies;
 
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
     std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
+    if (indices.transferFamily.has_value())
+        uniqueQueueFamilies.insert(indices.transferFamily.value());
 
     float queuePriority = 1.0f;
     for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -501,18 +1280,77 @@ void SampleRender::VKContext::CreateDevice()
         queueCreateInfos.push_back(queueCreateInfo);
     }
 
-    VkPhysicalDeviceFeatures deviceFeatures{};
+    VkPhysicalDeviceVulkan12Features vulkan12Features{};
+    vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    vulkan12Features.timelineSemaphore = VK_TRUE;
+    vulkan12Features.drawIndirectCount = m_DrawIndirectCount;
+    vulkan12Features.descriptorIndexing = m_Bindless;
+    vulkan12Features.runtimeDescriptorArray = m_Bindless;
+    vulkan12Features.shaderSampledImageArrayNonUniformIndexing = m_Bindless;
+    vulkan12Features.descriptorBindingPartiallyBound = m_Bindless;
+    vulkan12Features.descriptorBindingSampledImageUpdateAfterBind = m_Bindless;
+    vulkan12Features.descriptorBindingUpdateUnusedWhilePending = m_Bindless;
+
+    //optional features are prepended to the chain
+    void* featureChain = &vulkan12Features;
+
+    VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+    presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+    presentWaitFeatures.presentWait = VK_TRUE;
+    VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+    presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+    presentIdFeatures.presentId = VK_TRUE;
+    if (m_LowLatency)
+    {
+        presentWaitFeatures.pNext = featureChain;
+        presentIdFeatures.pNext = &presentWaitFeatures;
+        featureChain = &presentIdFeatures;
+    }
+
+    VkPhysicalDeviceShaderObjectFeaturesEXT shaderObjectFeatures{};
+    shaderObjectFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_OBJECT_FEATURES_EXT;
+    shaderObjectFeatures.shaderObject = VK_TRUE;
+    if (m_ShaderObject)
+    {
+        shaderObjectFeatures.pNext = featureChain;
+        featureChain = &shaderObjectFeatures;
+    }
+
+    VkPhysicalDeviceVulkan13Features vulkan13Features{};
+    vulkan13Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+    vulkan13Features.dynamicRendering = VK_TRUE;
+    if (m_DynamicRendering)
+    {
+        vulkan13Features.pNext = featureChain;
+        featureChain = &vulkan13Features;
+    }
+
+    VkPhysicalDeviceHostImageCopyFeaturesEXT hostImageCopyFeatures{};
+    hostImageCopyFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_FEATURES_EXT;
+    hostImageCopyFeatures.hostImageCopy = VK_TRUE;
+    if (m_HostImageCopy)
+    {
+        hostImageCopyFeatures.pNext = featureChain;
+        featureChain = &hostImageCopyFeatures;
+    }
+
+    VkPhysicalDeviceFeatures2 deviceFeatures{};
+    deviceFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    deviceFeatures.pNext = featureChain;
+    deviceFeatures.features.multiDrawIndirect = m_MultiDrawIndirect;
+    deviceFeatures.features.drawIndirectFirstInstance = m_DrawIndirectFirstInstance;
 
     VkDeviceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    createInfo.pNext = &deviceFeatures;
 
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
-    createInfo.pEnabledFeatures = &deviceFeatures;
+    createInfo.pEnabledFeatures = nullptr;
 
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-    createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(m_DeviceExtensions.size());
+    createInfo.ppEnabledExtensionNames = m_DeviceExtensions.data();
 
 #ifdef RENDER_DEBUG_MODE
     createInfo.enabledLayerCount = static_cast<uint32_t>(s_ValidationLayers.size());
@@ -525,6 +1363,32 @@ void SampleRender::VKContext::CreateDevice()
 
     vkGetDeviceQueue(m_Device, indices.graphicsFamily.value(), 0, &m_GraphicsQueue);
     vkGetDeviceQueue(m_Device, indices.presentFamily.value(), 0, &m_PresentQueue);
+    if (indices.transferFamily.has_value())
+        vkGetDeviceQueue(m_Device, indices.transferFamily.value(), 0, &m_TransferQueue);
+
+    if (m_LowLatency)
+        m_WaitForPresent = (PFN_vkWaitForPresentKHR)vkGetDeviceProcAddr(m_Device, "vkWaitForPresentKHR");
+
+    if (m_HostImageCopy)
+    {
+        m_HostImageCopyDispatch.CopyMemoryToImage = (PFN_vkCopyMemoryToImageEXT)vkGetDeviceProcAddr(m_Device, "vkCopyMemoryToImageEXT");
+        m_HostImageCopyDispatch.TransitionImageLayout = (PFN_vkTransitionImageLayoutEXT)vkGetDeviceProcAddr(m_Device, "vkTransitionImageLayoutEXT");
+    }
+
+    if (m_ShaderObject)
+    {
+        m_ShaderObjectDispatch.CreateShaders = (PFN_vkCreateShadersEXT)vkGetDeviceProcAddr(m_Device, "vkCreateShadersEXT");
+        m_ShaderObjectDispatch.DestroyShader = (PFN_vkDestroyShaderEXT)vkGetDeviceProcAddr(m_Device, "vkDestroyShaderEXT");
+        m_ShaderObjectDispatch.CmdBindShaders = (PFN_vkCmdBindShadersEXT)vkGetDeviceProcAddr(m_Device, "vkCmdBindShadersEXT");
+        m_ShaderObjectDispatch.CmdSetPolygonMode = (PFN_vkCmdSetPolygonModeEXT)vkGetDeviceProcAddr(m_Device, "vkCmdSetPolygonModeEXT");
+        m_ShaderObjectDispatch.CmdSetRasterizationSamples = (PFN_vkCmdSetRasterizationSamplesEXT)vkGetDeviceProcAddr(m_Device, "vkCmdSetRasterizationSamplesEXT");
+        m_ShaderObjectDispatch.CmdSetSampleMask = (PFN_vkCmdSetSampleMaskEXT)vkGetDeviceProcAddr(m_Device, "vkCmdSetSampleMaskEXT");
+        m_ShaderObjectDispatch.CmdSetAlphaToCoverageEnable = (PFN_vkCmdSetAlphaToCoverageEnableEXT)vkGetDeviceProcAddr(m_Device, "vkCmdSetAlphaToCoverageEnableEXT");
+        m_ShaderObjectDispatch.CmdSetColorBlendEnable = (PFN_vkCmdSetColorBlendEnableEXT)vkGetDeviceProcAddr(m_Device, "vkCmdSetColorBlendEnableEXT");
+        m_ShaderObjectDispatch.CmdSetColorBlendEquation = (PFN_vkCmdSetColorBlendEquationEXT)vkGetDeviceProcAddr(m_Device, "vkCmdSetColorBlendEquationEXT");
+        m_ShaderObjectDispatch.CmdSetColorWriteMask = (PFN_vkCmdSetColorWriteMaskEXT)vkGetDeviceProcAddr(m_Device, "vkCmdSetColorWriteMaskEXT");
+        m_ShaderObjectDispatch.CmdSetVertexInput = (PFN_vkCmdSetVertexInputEXT)vkGetDeviceProcAddr(m_Device, "vkCmdSetVertexInputEXT");
+    }
 }
 
 void SampleRender::VKContext::CreateViewportAndScissor(uint32_t width, uint32_t height)
@@ -552,6 +1416,8 @@ void SampleRender::VKContext::CreateSwapChain()
     VkExtent2D extent = ChooseSwapExtent(swapChainSupport.capabilities);
 
     uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
+    if (m_Settings.SwapChainImages > 0)
+        imageCount = std::max(m_Settings.SwapChainImages, swapChainSupport.capabilities.minImageCount);
     if (swapChainSupport.capabilities.maxImageCount > 0 && imageCount > swapChainSupport.capabilities.maxImageCount) {
         imageCount = swapChainSupport.capabilities.maxImageCount;
     }
@@ -567,7 +1433,7 @@ void SampleRender::VKContext::CreateSwapChain()
     createInfo.imageArrayLayers = 1;
     createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 
-    QueueFamilyIndices indices = FindQueueFamilies(m_Adapter);
+    QueueFamilyIndices indices = m_QueueFamilies;
     uint32_t queueFamilyIndices[] = { indices.graphicsFamily.value(), indices.presentFamily.value() };
 
     if (indices.graphicsFamily != indices.presentFamily) {
@@ -584,8 +1450,22 @@ void SampleRender::VKContext::CreateSwapChain()
     createInfo.presentMode = presentMode;
     createInfo.clipped = VK_TRUE;
 
+    VkSwapchainKHR oldSwapChain = m_SwapChain;
+    createInfo.oldSwapchain = oldSwapChain;
+
     vkr =vkCreateSwapchainKHR(m_Device, &createInfo, nullptr, &m_SwapChain);
     assert(vkr == VK_SUCCESS);
+    //present ids only have to grow within a swapchain
+    m_PresentId = 0;
+
+    if (oldSwapChain != VK_NULL_HANDLE)
+    {
+        VkDevice device = m_Device;
+        EnqueueDestruction([device, oldSwapChain]()
+        {
+            vkDestroySwapchainKHR(device, oldSwapChain, nullptr);
+        });
+    }
 
     vkGetSwapchainImagesKHR(m_Device, m_SwapChain, &imageCount, nullptr);
     m_SwapChainImageCount = imageCount;
@@ -609,13 +1489,28 @@ VkSurfaceFormatKHR SampleRender::VKContext::ChooseSwapSurfaceFormat(const std::v
 
 VkPresentModeKHR SampleRender::VKContext::ChooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes)
 {
+    VkPresentModeKHR requestedPresentMode = VK_PRESENT_MODE_FIFO_KHR;
+    switch (m_Settings.Present)
+    {
+    case PresentMode::FIFO_RELAXED:
+        requestedPresentMode = VK_PRESENT_MODE_FIFO_RELAXED_KHR; break;
+    case PresentMode::MAILBOX:
+        requestedPresentMode = VK_PRESENT_MODE_MAILBOX_KHR; break;
+    case PresentMode::IMMEDIATE:
+        requestedPresentMode = VK_PRESENT_MODE_IMMEDIATE_KHR; break;
+    default:
+        break;
+    }
+
     for (const auto& availablePresentMode : availablePresentModes) {
-        if (availablePresentMode == VK_PRESENT_MODE_FIFO_KHR) {
+        if (availablePresentMode == requestedPresentMode) {
             return availablePresentMode;
         }
     }
 
-    return VK_PRESENT_MODE_IMMEDIATE_KHR;
+    //FIFO is the only mode every implementation must support
+    Console::CoreWarn("Requested present mode is not supported, falling back to FIFO");
+    return VK_PRESENT_MODE_FIFO_KHR;
 }
 
 VkExtent2D SampleRender::VKContext::ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities)
@@ -644,15 +1539,55 @@ void SampleRender::VKContext::CleanupSwapChain()
 
 void SampleRender::VKContext::RecreateSwapChain()
 {
-    CleanupFramebuffers();
-    CleanupDepthStencilView();
-    CleanupImageView();
-    CleanupSwapChain();
-
-    CreateSwapChain();
+    RetireSwapChainTargets();
+    if (m_Headless)
+        CreateOffscreenTargets();
+    else
+        CreateSwapChain();
     CreateImageView();
     CreateDepthStencilView();
-    CreateFramebuffers();
+    if (!m_DynamicRendering)
+        CreateFramebuffers();
+}
+
+void SampleRender::VKContext::RetireSwapChainTargets()
+{
+    VkDevice device = m_Device;
+    std::vector<VkFramebuffer> framebuffers;
+    if (m_SwapChainFramebuffers != nullptr)
+        framebuffers.assign(m_SwapChainFramebuffers, m_SwapChainFramebuffers + m_SwapChainImageCount);
+    std::vector<VkImageView> imageViews(m_SwapChainImageViews, m_SwapChainImageViews + m_SwapChainImageCount);
+    std::vector<VkImage> offscreenImages;
+    std::vector<VKAllocation> offscreenMemories;
+    if (m_Headless)
+    {
+        offscreenImages.assign(m_SwapChainImages, m_SwapChainImages + m_SwapChainImageCount);
+        offscreenMemories.assign(m_OffscreenMemories, m_OffscreenMemories + m_SwapChainImageCount);
+        delete[] m_OffscreenMemories;
+    }
+    //swapchain images belong to the swapchain, which is retired by CreateSwapChain through oldSwapchain
+    delete[] m_SwapChainImages;
+    delete[] m_SwapChainImageViews;
+    delete[] m_SwapChainFramebuffers;
+    m_SwapChainFramebuffers = nullptr;
+
+    VKMemoryAllocator* allocator = m_MemoryAllocator.get();
+    EnqueueDestruction([device, allocator, framebuffers, imageViews, offscreenImages, offscreenMemories,
+        depthStencilView = m_DepthStencilView, depthStencilBuffer = m_DepthStencilBuffer, depthStencilMemory = m_DepthStencilMemory]()
+    {
+        for (auto framebuffer : framebuffers)
+            vkDestroyFramebuffer(device, framebuffer, nullptr);
+        for (auto imageView : imageViews)
+            vkDestroyImageView(device, imageView, nullptr);
+        vkDestroyImageView(device, depthStencilView, nullptr);
+        vkDestroyImage(device, depthStencilBuffer, nullptr);
+        allocator->Free(depthStencilMemory);
+        for (size_t i = 0; i < offscreenImages.size(); i++)
+        {
+            vkDestroyImage(device, offscreenImages[i], nullptr);
+            allocator->Free(offscreenMemories[i]);
+        }
+    });
 }
 
 void SampleRender::VKContext::CreateImageView()
@@ -690,6 +1625,49 @@ void SampleRender::VKContext::CleanupImageView()
     delete[] m_SwapChainImageViews;
 }
 
+void SampleRender::VKContext::CreateOffscreenTargets()
+{
+    VkResult vkr;
+    m_SwapChainImageCount = m_FramesInFlight;
+    m_SwapChainImageFormat = VK_FORMAT_B8G8R8A8_UNORM;
+    m_SwapChainExtent = { (uint32_t)m_Viewport.width, (uint32_t)m_Viewport.height };
+    m_SwapChainImages = new VkImage[m_SwapChainImageCount];
+    m_OffscreenMemories = new VKAllocation[m_SwapChainImageCount];
+
+    for (size_t i = 0; i < m_SwapChainImageCount; i++) {
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent.width = m_SwapChainExtent.width;
+        imageInfo.extent.height = m_SwapChainExtent.height;
+        imageInfo.extent.depth = 1;
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = m_SwapChainImageFormat;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        vkr = vkCreateImage(m_Device, &imageInfo, nullptr, &m_SwapChainImages[i]);
+        assert(vkr == VK_SUCCESS);
+
+        m_OffscreenMemories[i] = m_MemoryAllocator->AllocateImage(m_SwapChainImages[i], VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    }
+}
+
+void SampleRender::VKContext::CleanupOffscreenTargets()
+{
+    for (size_t i = 0; i < m_SwapChainImageCount; i++)
+    {
+        vkDestroyImage(m_Device, m_SwapChainImages[i], nullptr);
+        m_MemoryAllocator->Free(m_OffscreenMemories[i]);
+    }
+    delete[] m_SwapChainImages;
+    delete[] m_OffscreenMemories;
+}
+
 void SampleRender::VKContext::CreateRenderPass()
 {
     VkResult vkr;
@@ -701,14 +1679,14 @@ void SampleRender::VKContext::CreateRenderPass()
     colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    colorAttachment.finalLayout = m_Headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
     VkAttachmentReference colorAttachmentRef{};
     colorAttachmentRef.attachment = 0;
     colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
     VkAttachmentDescription depthAttachment{};
-    depthAttachment.format = VK_FORMAT_D24_UNORM_S8_UINT;
+    depthAttachment.format = m_DepthFormat;
     depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
     depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
     depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
@@ -749,6 +1727,88 @@ void SampleRender::VKContext::CreateRenderPass()
     assert(vkr == VK_SUCCESS);
 }
 
+void SampleRender::VKContext::BeginDynamicRendering()
+{
+    auto commandBuffer = m_CommandBuffers[m_CurrentBufferIndex];
+
+    //both targets are cleared on load, so whatever layout they were left in can be discarded
+    VkImageMemoryBarrier barriers[2]{};
+    barriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barriers[0].srcAccessMask = 0;
+    barriers[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    barriers[0].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barriers[0].newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barriers[0].image = m_SwapChainImages[m_CurrentImageIndex];
+    barriers[0].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+    VkImageAspectFlags depthAspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+    if (m_DepthFormat != VK_FORMAT_D32_SFLOAT)
+        depthAspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+    barriers[1].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barriers[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    barriers[1].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barriers[1].newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    barriers[1].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barriers[1].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barriers[1].image = m_DepthStencilBuffer;
+    barriers[1].subresourceRange = { depthAspect, 0, 1, 0, 1 };
+
+    VkPipelineStageFlags attachmentStages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    vkCmdPipelineBarrier(commandBuffer, attachmentStages, attachmentStages, 0, 0, nullptr, 0, nullptr, 2, barriers);
+
+    VkRenderingAttachmentInfo colorAttachment{};
+    colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+    colorAttachment.imageView = m_SwapChainImageViews[m_CurrentImageIndex];
+    colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.clearValue.color = m_ClearColor;
+
+    VkRenderingAttachmentInfo depthAttachment{};
+    depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+    depthAttachment.imageView = m_DepthStencilView;
+    depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.clearValue.depthStencil = { 1.0f, 0 };
+
+    VkRenderingInfo renderingInfo{};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+    renderingInfo.flags = (m_RecordingWorkers > 0) ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT : 0;
+    renderingInfo.renderArea.offset = { 0, 0 };
+    renderingInfo.renderArea.extent = m_SwapChainExtent;
+    renderingInfo.layerCount = 1;
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachments = &colorAttachment;
+    renderingInfo.pDepthAttachment = &depthAttachment;
+
+    vkCmdBeginRendering(commandBuffer, &renderingInfo);
+}
+
+void SampleRender::VKContext::EndDynamicRendering()
+{
+    auto commandBuffer = m_CommandBuffers[m_CurrentBufferIndex];
+    vkCmdEndRendering(commandBuffer);
+
+    //same final layouts the render pass uses
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    barrier.dstAccessMask = m_Headless ? VK_ACCESS_TRANSFER_READ_BIT : 0;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    barrier.newLayout = m_Headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = m_SwapChainImages[m_CurrentImageIndex];
+    barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+    VkPipelineStageFlags dstStage = m_Headless ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
 void SampleRender::VKContext::CreateFramebuffers()
 {
     VkResult vkr;
@@ -776,6 +1836,8 @@ void SampleRender::VKContext::CreateFramebuffers()
 
 void SampleRender::VKContext::CleanupFramebuffers()
 {
+    if (m_SwapChainFramebuffers == nullptr)
+        return;
     for (size_t i = 0; i < m_SwapChainImageCount; i++)
     {
         vkDestroyFramebuffer(m_Device, m_SwapChainFramebuffers[i], nullptr);
@@ -795,7 +1857,7 @@ void SampleRender::VKContext::CreateDepthStencilView()
     imageInfo.extent.depth = 1;
     imageInfo.mipLevels = 1;
     imageInfo.arrayLayers = 1;
-    imageInfo.format = VK_FORMAT_D24_UNORM_S8_UINT;
+    imageInfo.format = m_DepthFormat;
     imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
     imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
@@ -805,34 +1867,13 @@ void SampleRender::VKContext::CreateDepthStencilView()
     vkr = vkCreateImage(m_Device, &imageInfo, nullptr, &m_DepthStencilBuffer);
     (vkr == VK_SUCCESS);
 
-    VkMemoryRequirements memRequirements;
-    vkGetImageMemoryRequirements(m_Device, m_DepthStencilBuffer, &memRequirements);
-
-    VkPhysicalDeviceMemoryProperties memProperties;
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = 0xffffffffu;
-        
-    vkGetPhysicalDeviceMemoryProperties(m_Adapter, &memProperties);
-
-    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-        if ((memRequirements.memoryTypeBits & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) == VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) {
-            allocInfo.memoryTypeIndex = i;
-        }
-    }
-        
-
-    vkr = vkAllocateMemory(m_Device, &allocInfo, nullptr, &m_DepthStencilMemory);
-    assert(vkr == VK_SUCCESS);
-
-    vkBindImageMemory(m_Device, m_DepthStencilBuffer, m_DepthStencilMemory, 0);
+    m_DepthStencilMemory = m_MemoryAllocator->AllocateImage(m_DepthStencilBuffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
   
     VkImageViewCreateInfo viewInfo{};
     viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
     viewInfo.image = m_DepthStencilBuffer;
     viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    viewInfo.format = VK_FORMAT_D24_UNORM_S8_UINT;
+    viewInfo.format = m_DepthFormat;
     viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
     viewInfo.subresourceRange.baseMipLevel = 0;
     viewInfo.subresourceRange.levelCount = 1;
@@ -847,20 +1888,28 @@ void SampleRender::VKContext::CleanupDepthStencilView()
 {
     vkDestroyImageView(m_Device, m_DepthStencilView, nullptr);
     vkDestroyImage(m_Device, m_DepthStencilBuffer, nullptr);
-    vkFreeMemory(m_Device, m_DepthStencilMemory, nullptr);
+    m_MemoryAllocator->Free(m_DepthStencilMemory);
 }
 
-void SampleRender::VKContext::CreateCommandPool()
+void SampleRender::VKContext::CreateCommandPools()
 {
     VkResult vkr;
-    QueueFamilyIndices queueFamilyIndices = FindQueueFamilies(m_Adapter);
+    QueueFamilyIndices queueFamilyIndices = m_QueueFamilies;
+    m_CommandPools = new VkCommandPool[m_FramesInFlight];
 
     VkCommandPoolCreateInfo poolInfo{};
     poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
     poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
 
-    vkr = vkCreateCommandPool(m_Device, &poolInfo, nullptr, &m_CommandPool);
+    for (size_t i = 0; i < m_FramesInFlight; i++) {
+        vkr = vkCreateCommandPool(m_Device, &poolInfo, nullptr, &m_CommandPools[i]);
+        assert(vkr == VK_SUCCESS);
+    }
+
+    //one-shot buffers are recycled one by one, so this pool needs per buffer reset
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    vkr = vkCreateCommandPool(m_Device, &poolInfo, nullptr, &m_OneShotCommandPool);
     assert(vkr == VK_SUCCESS);
 }
 
@@ -871,12 +1920,65 @@ void SampleRender::VKContext::CreateCommandBuffers()
 
     VkCommandBufferAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.commandPool = m_CommandPool;
     allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandBufferCount = m_FramesInFlight;
+    allocInfo.commandBufferCount = 1;
 
-    vkr = vkAllocateCommandBuffers(m_Device, &allocInfo, m_CommandBuffers);
-    assert(vkr == VK_SUCCESS);
+    for (size_t i = 0; i < m_FramesInFlight; i++) {
+        allocInfo.commandPool = m_CommandPools[i];
+        vkr = vkAllocateCommandBuffers(m_Device, &allocInfo, &m_CommandBuffers[i]);
+        assert(vkr == VK_SUCCESS);
+    }
+}
+
+void SampleRender::VKContext::CreateWorkerCommandBuffers()
+{
+    VkResult vkr;
+    uint32_t count = m_FramesInFlight * m_RecordingWorkers;
+    m_WorkerRecorded.assign(m_RecordingWorkers, 0);
+    if (count == 0)
+        return;
+
+    m_WorkerCommandPools = new VkCommandPool[count];
+    m_WorkerCommandBuffers = new VkCommandBuffer[count];
+
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolInfo.queueFamilyIndex = m_QueueFamilies.graphicsFamily.value();
+
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+    allocInfo.commandBufferCount = 1;
+
+    //one pool per worker and frame, command pools cannot be shared across threads
+    for (uint32_t i = 0; i < count; i++) {
+        vkr = vkCreateCommandPool(m_Device, &poolInfo, nullptr, &m_WorkerCommandPools[i]);
+        assert(vkr == VK_SUCCESS);
+
+        allocInfo.commandPool = m_WorkerCommandPools[i];
+        vkr = vkAllocateCommandBuffers(m_Device, &allocInfo, &m_WorkerCommandBuffers[i]);
+        assert(vkr == VK_SUCCESS);
+    }
+}
+
+void SampleRender::VKContext::RetireWorkerCommandBuffers()
+{
+    if (m_WorkerCommandPools == nullptr)
+        return;
+
+    VkDevice device = m_Device;
+    std::vector<VkCommandPool> pools(m_WorkerCommandPools, m_WorkerCommandPools + m_FramesInFlight * m_RecordingWorkers);
+    EnqueueDestruction([device, pools]()
+    {
+        for (auto pool : pools)
+            vkDestroyCommandPool(device, pool, nullptr);
+    });
+    delete[] m_WorkerCommandPools;
+    delete[] m_WorkerCommandBuffers;
+    m_WorkerCommandPools = nullptr;
+    m_WorkerCommandBuffers = nullptr;
+    m_RecordingWorkers = 0;
 }
 
 void SampleRender::VKContext::CreateSyncObjects()
@@ -884,25 +1986,227 @@ void SampleRender::VKContext::CreateSyncObjects()
     VkResult vkr;
     m_ImageAvailableSemaphores = new VkSemaphore[m_FramesInFlight];
     m_RenderFinishedSemaphores = new VkSemaphore[m_FramesInFlight];
-    m_InFlightFences = new VkFence[m_FramesInFlight];
+    m_FrameTimelineValues = new uint64_t[m_FramesInFlight];
 
     VkSemaphoreCreateInfo semaphoreInfo{};
     semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-    VkFenceCreateInfo fenceInfo{};
-    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
     for (size_t i = 0; i < m_FramesInFlight; i++) {
         vkr = vkCreateSemaphore(m_Device, &semaphoreInfo, nullptr, &m_ImageAvailableSemaphores[i]);
         assert(vkr == VK_SUCCESS);
         vkr = vkCreateSemaphore(m_Device, &semaphoreInfo, nullptr, &m_RenderFinishedSemaphores[i]);
         assert(vkr == VK_SUCCESS);
-        vkr = vkCreateFence(m_Device, &fenceInfo, nullptr, &m_InFlightFences[i]);
+        m_FrameTimelineValues[i] = 0;
+    }
+
+    VkSemaphoreTypeCreateInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    timelineInfo.initialValue = 0;
+    semaphoreInfo.pNext = &timelineInfo;
+
+    vkr = vkCreateSemaphore(m_Device, &semaphoreInfo, nullptr, &m_TimelineSemaphore);
+    assert(vkr == VK_SUCCESS);
+}
+
+void SampleRender::VKContext::CompactMemory()
+{
+    if (m_Settings.DefragmentationBudget == 0)
+        return;
+
+    uint64_t submittedValue;
+    {
+        std::lock_guard<std::mutex> lock(m_QueueMutex);
+        submittedValue = m_TimelineValue;
+    }
+    bool gpuIdle = GetCompletedTimelineValue() >= submittedValue;
+    //read before the allocator locks, uploads take the allocator lock while holding their own
+    uint64_t completedUpload = m_UploadManager->GetCompletedTicket();
+    m_MemoryAllocator->Defragment((VkDeviceSize)m_Settings.DefragmentationBudget << 20, gpuIdle, completedUpload);
+}
+
+void SampleRender::VKContext::ReleaseCompletedResources()
+{
+    uint64_t completedValue = GetCompletedTimelineValue();
+    uint64_t completedUpload = m_UploadManager->GetCompletedTicket();
+    //both values only grow along the queue, the first entry still in use stops the walk, nothing waits
+    while (!m_DestructionQueue.empty() && (m_DestructionQueue.front().FrameValue <= completedValue) && (m_DestructionQueue.front().UploadTicket <= completedUpload))
+    {
+        m_DestructionQueue.front().Destroyer();
+        m_DestructionQueue.pop_front();
+    }
+}
+
+void SampleRender::VKContext::FlushDestructionQueue()
+{
+    for (auto& destruction : m_DestructionQueue)
+        destruction.Destroyer();
+    m_DestructionQueue.clear();
+    for (auto& destroyer : m_PendingDestruction)
+        destroyer();
+    m_PendingDestruction.clear();
+}
+
+void SampleRender::VKContext::CreatePipelineCache()
+{
+    VkResult vkr;
+
+    VkPhysicalDeviceIDProperties idProperties{};
+    idProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+    VkPhysicalDeviceProperties2 properties{};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &idProperties;
+    vkGetPhysicalDeviceProperties2(m_Adapter, &properties);
+
+    std::byte* fileData = nullptr;
+    size_t fileSize = 0;
+    const void* initialData = nullptr;
+    size_t initialDataSize = 0;
+
+    if (!m_Settings.PipelineCachePath.empty() && FileHandler::FileExists(m_Settings.PipelineCachePath) &&
+        FileHandler::ReadBinFile(m_Settings.PipelineCachePath, &fileData, &fileSize))
+    {
+        PipelineCacheHeader header{};
+        bool valid = fileSize >= sizeof(PipelineCacheHeader);
+        if (valid)
+        {
+            memcpy(&header, fileData, sizeof(PipelineCacheHeader));
+            valid = (header.Magic == s_PipelineCacheMagic) && (header.Version == s_PipelineCacheVersion) &&
+                (header.VendorID == properties.properties.vendorID) && (header.DeviceID == properties.properties.deviceID) &&
+                (header.DriverVersion == properties.properties.driverVersion) &&
+                (memcmp(header.DeviceUUID, idProperties.deviceUUID, VK_UUID_SIZE) == 0) &&
+                (memcmp(header.PipelineCacheUUID, properties.properties.pipelineCacheUUID, VK_UUID_SIZE) == 0) &&
+                (header.DataSize == fileSize - sizeof(PipelineCacheHeader));
+        }
+
+        if (valid)
+        {
+            initialData = fileData + sizeof(PipelineCacheHeader);
+            initialDataSize = (size_t)header.DataSize;
+            Console::CoreLog("Loaded pipeline cache {} ({} bytes)", m_Settings.PipelineCachePath, initialDataSize);
+        }
+        else
+            Console::CoreWarn("Pipeline cache {} belongs to another device or driver, starting cold", m_Settings.PipelineCachePath);
+    }
+
+    VkPipelineCacheCreateInfo cacheInfo{};
+    cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cacheInfo.initialDataSize = initialDataSize;
+    cacheInfo.pInitialData = initialData;
+
+    vkr = vkCreatePipelineCache(m_Device, &cacheInfo, nullptr, &m_PipelineCache);
+    assert(vkr == VK_SUCCESS);
+
+    delete[] fileData;
+
+    m_PipelineManifest.reset(new VKPipelineManifest(m_Settings.PipelineManifestPath, m_Settings.RecordPipelineManifest));
+}
+
+void SampleRender::VKContext::SavePipelineCache()
+{
+    if ((m_PipelineCacheHits > 0) || (m_PipelineCacheMisses > 0))
+        Console::CoreLog("Pipeline cache: {} hits, {} misses", m_PipelineCacheHits.load(), m_PipelineCacheMisses.load());
+
+    if (m_Settings.PipelineCachePath.empty())
+        return;
+
+    VkResult vkr;
+    size_t dataSize = 0;
+    vkr = vkGetPipelineCacheData(m_Device, m_PipelineCache, &dataSize, nullptr);
+    if ((vkr != VK_SUCCESS) || (dataSize == 0))
+        return;
+
+    std::vector<std::byte> fileData(sizeof(PipelineCacheHeader) + dataSize);
+    vkr = vkGetPipelineCacheData(m_Device, m_PipelineCache, &dataSize, fileData.data() + sizeof(PipelineCacheHeader));
+    if (vkr != VK_SUCCESS)
+        return;
+
+    VkPhysicalDeviceIDProperties idProperties{};
+    idProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+    VkPhysicalDeviceProperties2 properties{};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &idProperties;
+    vkGetPhysicalDeviceProperties2(m_Adapter, &properties);
+
+    PipelineCacheHeader header{};
+    header.Magic = s_PipelineCacheMagic;
+    header.Version = s_PipelineCacheVersion;
+    header.VendorID = properties.properties.vendorID;
+    header.DeviceID = properties.properties.deviceID;
+    header.DriverVersion = properties.properties.driverVersion;
+    memcpy(header.DeviceUUID, idProperties.deviceUUID, VK_UUID_SIZE);
+    memcpy(header.PipelineCacheUUID, properties.properties.pipelineCacheUUID, VK_UUID_SIZE);
+    header.DataSize = dataSize;
+    memcpy(fileData.data(), &header, sizeof(PipelineCacheHeader));
+
+    if (!FileHandler::WriteBinFile(m_Settings.PipelineCachePath, fileData.data(), sizeof(PipelineCacheHeader) + dataSize))
+        Console::CoreWarn("Failed to write pipeline cache {}", m_Settings.PipelineCachePath);
+}
+
+void SampleRender::VKContext::CreateTimestampQueries()
+{
+    VkResult vkr;
+    m_TimestampQueryPools = new VkQueryPool[m_FramesInFlight];
+    m_TimestampNames = new std::vector<std::string>[m_FramesInFlight];
+
+    VkPhysicalDeviceProperties adapterProperties;
+    vkGetPhysicalDeviceProperties(m_Adapter, &adapterProperties);
+    m_TimestampPeriod = adapterProperties.limits.timestampPeriod;
+
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(m_Adapter, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(m_Adapter, &queueFamilyCount, queueFamilies.data());
+    m_TimestampsSupported = (queueFamilies[m_QueueFamilies.graphicsFamily.value()].timestampValidBits > 0) && (m_TimestampPeriod > 0.0f);
+
+    VkQueryPoolCreateInfo queryPoolInfo{};
+    queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolInfo.queryCount = s_MaxTimestampScopes * 2;
+
+    for (size_t i = 0; i < m_FramesInFlight; i++) {
+        m_TimestampQueryPools[i] = VK_NULL_HANDLE;
+        if (!m_TimestampsSupported)
+            continue;
+        vkr = vkCreateQueryPool(m_Device, &queryPoolInfo, nullptr, &m_TimestampQueryPools[i]);
         assert(vkr == VK_SUCCESS);
     }
 }
 
+void SampleRender::VKContext::ReadTimestampQueries()
+{
+    //called right after the frame fence wait, so the results are already on the host
+    auto& names = m_TimestampNames[m_CurrentBufferIndex];
+    if (names.empty())
+        return;
+
+    std::vector<uint64_t> ticks(names.size() * 2);
+    VkResult result = vkGetQueryPoolResults(m_Device, m_TimestampQueryPools[m_CurrentBufferIndex], 0, (uint32_t)ticks.size(),
+        ticks.size() * sizeof(uint64_t), ticks.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+
+    if (result == VK_SUCCESS)
+    {
+        m_GPUTimestamps.clear();
+        for (size_t i = 0; i < names.size(); i++)
+        {
+            double nanoseconds = (double)(ticks[i * 2 + 1] - ticks[i * 2]) * m_TimestampPeriod;
+            m_GPUTimestamps.push_back({ names[i], nanoseconds / 1000000.0 });
+        }
+    }
+    names.clear();
+}
+
+void SampleRender::VKContext::CleanupTimestampQueries()
+{
+    for (size_t i = 0; i < m_FramesInFlight; i++)
+    {
+        if (m_TimestampQueryPools[i] != VK_NULL_HANDLE)
+            vkDestroyQueryPool(m_Device, m_TimestampQueryPools[i], nullptr);
+    }
+    delete[] m_TimestampQueryPools;
+    delete[] m_TimestampNames;
+}
+
 #ifdef RENDER_DEBUG_MODE
 
 void SampleRender::VKContext::SetupDebugMessage()
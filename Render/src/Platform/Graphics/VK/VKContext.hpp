@@ -2,22 +2,76 @@
 
 #include "GraphicsContext.hpp"
 #include "ComPointer.hpp"
+#include "VKMemoryAllocator.hpp"
 #include <vector>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <memory>
+#include <atomic>
 
 #include <vulkan/vulkan.h>
 #include <optional>
 
 namespace SampleRender
 {
+	class VKUploadManager;
+	class VKFrameAllocator;
+	class VKDescriptorAllocator;
+	class VKBindlessHeap;
+	class VKPipelineManifest;
+
 	struct QueueFamilyIndices {
 		std::optional<uint32_t> graphicsFamily;
 		std::optional<uint32_t> presentFamily;
+		//only set when the device exposes a transfer-only family
+		std::optional<uint32_t> transferFamily;
 
 		bool isComplete() {
 			return graphicsFamily.has_value() && presentFamily.has_value();
 		}
 	};
 
+	//Prefixes the driver blob on disk, a mismatch on any field discards the cache
+	struct PipelineCacheHeader {
+		uint32_t Magic;
+		uint32_t Version;
+		uint32_t VendorID;
+		uint32_t DeviceID;
+		uint32_t DriverVersion;
+		uint8_t DeviceUUID[VK_UUID_SIZE];
+		uint8_t PipelineCacheUUID[VK_UUID_SIZE];
+		uint64_t DataSize;
+	};
+
+	//VK_EXT_shader_object entry points, the core 1.3 dynamic state commands are called directly
+	struct ShaderObjectDispatch {
+		PFN_vkCreateShadersEXT CreateShaders = nullptr;
+		PFN_vkDestroyShaderEXT DestroyShader = nullptr;
+		PFN_vkCmdBindShadersEXT CmdBindShaders = nullptr;
+		PFN_vkCmdSetPolygonModeEXT CmdSetPolygonMode = nullptr;
+		PFN_vkCmdSetRasterizationSamplesEXT CmdSetRasterizationSamples = nullptr;
+		PFN_vkCmdSetSampleMaskEXT CmdSetSampleMask = nullptr;
+		PFN_vkCmdSetAlphaToCoverageEnableEXT CmdSetAlphaToCoverageEnable = nullptr;
+		PFN_vkCmdSetColorBlendEnableEXT CmdSetColorBlendEnable = nullptr;
+		PFN_vkCmdSetColorBlendEquationEXT CmdSetColorBlendEquation = nullptr;
+		PFN_vkCmdSetColorWriteMaskEXT CmdSetColorWriteMask = nullptr;
+		PFN_vkCmdSetVertexInputEXT CmdSetVertexInput = nullptr;
+	};
+
+	//VK_EXT_host_image_copy entry points, textures are written by the CPU without a staging buffer
+	struct HostImageCopyDispatch {
+		PFN_vkCopyMemoryToImageEXT CopyMemoryToImage = nullptr;
+		PFN_vkTransitionImageLayoutEXT TransitionImageLayout = nullptr;
+	};
+
+	//Freed once the frame is retired and the uploads flushed with it have been acquired
+	struct DeferredDestruction {
+		uint64_t FrameValue;
+		uint64_t UploadTicket;
+		std::function<void()> Destroyer;
+	};
+
 	struct SwapChainSupportDetails {
 		VkSurfaceCapabilitiesKHR capabilities;
 		std::vector<VkSurfaceFormatKHR> formats;
@@ -27,7 +81,9 @@ namespace SampleRender
 	class SAMPLE_RENDER_DLL_COMMAND VKContext : public GraphicsContext
 	{
 	public:
-		VKContext(const Window* windowHandle, uint32_t framesInFlight);
+		VKContext(const Window* windowHandle, const GraphicsSettings& settings);
+		//Headless, renders into an offscreen ring instead of a swapchain
+		VKContext(uint32_t width, uint32_t height, const GraphicsSettings& settings);
 		~VKContext();
 
 		void SetClearColor(float r, float g, float b, float a) override;
@@ -35,29 +91,90 @@ namespace SampleRender
 		uint32_t GetUniformAttachment() const override;
 		uint32_t GetSmallBufferAttachment() const override;
 
+		void PaceFrame() override;
 		void ReceiveCommands() override;
 		void DispatchCommands() override;
 		void Present() override;
 		void StageViewportAndScissors() override;
 
 		void Draw(uint32_t elements) override;
+		void DrawInstanced(uint32_t elements, uint32_t instances, uint32_t firstIndex = 0, int32_t baseVertex = 0, uint32_t firstInstance = 0) override;
+		void DrawIndexedIndirect(const IndirectBuffer* arguments, uint32_t drawCount, uint64_t argumentOffset = 0) override;
+		void DrawIndexedIndirectCount(const IndirectBuffer* arguments, const IndirectBuffer* countBuffer, uint32_t maxDraws, uint64_t argumentOffset = 0, uint64_t countOffset = 0) override;
+		void StageDynamicVertices(const void* data, size_t size, uint32_t stride, uint32_t bindingSlot = 0) override;
+		void StageDynamicIndices(const void* data, uint32_t count, IndexFormat format) override;
 
 		const std::string GetGPUName() override;
 
 		void WindowResize(uint32_t width, uint32_t height) override;
 
-		VkCommandPool GetCommandPool() const;
+		uint32_t SetRecordingWorkers(uint32_t workers) override;
+		void BeginWorkerCommands(uint32_t worker) override;
+		void EndWorkerCommands(uint32_t worker) override;
+
+		void BeginGPUTimestamp(std::string_view name) override;
+		void EndGPUTimestamp() override;
+		const std::vector<GPUTimestampScope>& GetGPUTimestamps() const override;
+		GPUMemoryStatistics GetMemoryStatistics() override;
+
+		void WarmUpPipelines(ThreadPool* pool) override;
+
 		VkQueue GetGraphicsQueue() const;
+		VkQueue GetTransferQueue() const;
 		VkPhysicalDevice GetAdapter() const;
 		VkDevice GetDevice() const;
 		VkRenderPass GetRenderPass() const;
 		VkCommandBuffer GetCurrentCommandBuffer() const;
 		VkSurfaceKHR GetSurface() const;
+		QueueFamilyIndices GetQueueFamilies() const;
+		bool IsHeadless() const;
+
+		//Runs the destroyer once every frame that may still reference the resources has finished on the GPU
+		void EnqueueDestruction(std::function<void()> destroyer);
+
+		//Submits on the graphics queue and returns the timeline value signaled on completion
+		uint64_t SubmitCommandBuffer(VkCommandBuffer commandBuffer);
+		void WaitTimelineValue(uint64_t value) const;
+		uint64_t GetCompletedTimelineValue() const;
+
+		//Recycled primary buffers for uploads and other work outside the frame
+		//The shared pool stays locked until SubmitOneShotCommands, so other threads wait instead of recording into it
+		VkCommandBuffer BeginOneShotCommands();
+		//Ends and submits the buffer and releases the lock, the buffer returns to the allocator once the returned value is reached
+		uint64_t SubmitOneShotCommands(VkCommandBuffer commandBuffer);
+
+		//Every buffer and image memory goes through it
+		VKMemoryAllocator* GetMemoryAllocator() const;
+		//Transient uniform, vertex and index space of the frame being recorded
+		VKFrameAllocator* GetFrameAllocator() const;
+		//Chained descriptor pools, persistent sets plus per-frame sets reset in bulk
+		VKDescriptorAllocator* GetDescriptorAllocator() const;
+		//Null unless bindless textures were requested and the device supports descriptor indexing
+		VKBindlessHeap* GetBindlessHeap() const;
+		//Batches staging copies, everything queued is submitted before the next frame at the latest
+		VKUploadManager* GetUploadManager() const;
+		//Shared by every pipeline, persisted between runs
+		VkPipelineCache GetPipelineCache() const;
+		bool IsCreationFeedbackEnabled() const;
+		VKPipelineManifest* GetPipelineManifest() const;
+		//Counts cache hits and misses from VK_EXT_pipeline_creation_feedback
+		void ReportPipelineCreation(std::string_view name, const VkPipelineCreationFeedbackEXT& feedback);
+		//Shaders are created as VkShaderEXT and every piece of state is set at record time
+		bool IsShaderObjectEnabled() const;
+		const ShaderObjectDispatch& GetShaderObjectDispatch() const;
+		//No render pass or framebuffers, pipelines are compiled against the attachment formats
+		bool IsDynamicRenderingEnabled() const;
+		VkPipelineRenderingCreateInfo GetPipelineRenderingInfo() const;
+		//Sampled textures can be copied and moved to SHADER_READ_ONLY_OPTIMAL from the host
+		bool IsHostImageCopyEnabled() const;
+		const HostImageCopyDispatch& GetHostImageCopyDispatch() const;
 	
 	private:
 		
 		//Master
 		void CreateInstance();
+		void CreateCoreObjects(uint32_t width, uint32_t height);
+		bool IsInstanceLayerAvailable(const char* layerName);
 		
 
 #ifdef RENDER_DEBUG_MODE
@@ -82,8 +199,11 @@ namespace SampleRender
 		bool CheckDeviceExtensionSupport(VkPhysicalDevice adapter);
 		SwapChainSupportDetails QuerySwapChainSupport(VkPhysicalDevice adapter);
 		void BufferizeUniformAttachment();
+		void SelectOptionalFeatures();
+		bool IsDeviceExtensionAvailable(const char* extensionName);
+		VkFormat FindDepthFormat();
 
-		static const std::vector<const char*> deviceExtensions;
+		std::vector<const char*> m_DeviceExtensions;
 
 		//Master
 		void CreateDevice();
@@ -100,15 +220,26 @@ namespace SampleRender
 		//Master Clean
 		void CleanupSwapChain();
 		void RecreateSwapChain();
+		//Hands the current targets to the destruction queue, frames in flight may still use them
+		void RetireSwapChainTargets();
 
 		//Master
 		void CreateImageView();
 		//Master Clean
 		void CleanupImageView();
 
+		//Headless
+		void CreateOffscreenTargets();
+		//Headless Clean
+		void CleanupOffscreenTargets();
+
 		//Master
 		void CreateRenderPass();
 
+		//Dynamic rendering, transitions the targets the render pass would otherwise handle
+		void BeginDynamicRendering();
+		void EndDynamicRendering();
+
 		//Master
 		void CreateFramebuffers();
 		//Master Clean
@@ -120,20 +251,59 @@ namespace SampleRender
 		void CleanupDepthStencilView();
 
 		//Master
-		void CreateCommandPool();
+		void CreateCommandPools();
 		//Master
 		void CreateCommandBuffers();
 		//Master
 		void CreateSyncObjects();
 
+		//Workers
+		void CreateWorkerCommandBuffers();
+		//Workers Clean
+		void RetireWorkerCommandBuffers();
+
+		//Deferred destruction
+		void ReleaseCompletedResources();
+		//Deferred destruction Clean
+		void FlushDestructionQueue();
+		//Spends the defragmentation budget, textures only move once the GPU has drained every frame
+		void CompactMemory();
+
+		//Pipeline cache
+		void CreatePipelineCache();
+		//Pipeline cache Clean
+		void SavePipelineCache();
+
+		//Profiling
+		void CreateTimestampQueries();
+		void ReadTimestampQueries();
+		//Profiling Clean
+		void CleanupTimestampQueries();
+
 		VkInstance m_Instance;
-		VkSurfaceKHR m_Surface;
+		VkSurfaceKHR m_Surface = VK_NULL_HANDLE;
 		VkPhysicalDevice m_Adapter = VK_NULL_HANDLE;
+		QueueFamilyIndices m_QueueFamilies;
+		bool m_Headless = false;
+		GraphicsSettings m_Settings;
+		bool m_LowLatency = false;
+		uint64_t m_PresentId = 0;
+		PFN_vkWaitForPresentKHR m_WaitForPresent = nullptr;
+		bool m_MultiDrawIndirect = false;
+		bool m_DrawIndirectFirstInstance = false;
+		bool m_DrawIndirectCount = false;
+		bool m_ShaderObject = false;
+		bool m_DynamicRendering = false;
+		ShaderObjectDispatch m_ShaderObjectDispatch;
+		bool m_HostImageCopy = false;
+		bool m_Bindless = false;
+		HostImageCopyDispatch m_HostImageCopyDispatch;
 		uint32_t m_UniformAttachment;
 		VkDevice m_Device;
 		VkQueue m_GraphicsQueue;
 		VkQueue m_PresentQueue;
-		VkSwapchainKHR m_SwapChain;
+		VkQueue m_TransferQueue = VK_NULL_HANDLE;
+		VkSwapchainKHR m_SwapChain = VK_NULL_HANDLE;
 		
 		VkClearColorValue m_ClearColor;
 
@@ -142,30 +312,81 @@ namespace SampleRender
 		VkFormat m_SwapChainImageFormat;
 		VkExtent2D m_SwapChainExtent;
 		VkImageView* m_SwapChainImageViews;
-		VkRenderPass m_RenderPass;
-		VkFramebuffer* m_SwapChainFramebuffers;
+		VKAllocation* m_OffscreenMemories;
+		VkRenderPass m_RenderPass = VK_NULL_HANDLE;
+		VkFramebuffer* m_SwapChainFramebuffers = nullptr;
 		
 		VkImage m_DepthStencilBuffer;
-		VkDeviceMemory m_DepthStencilMemory;
+		VKAllocation m_DepthStencilMemory;
 		VkImageView m_DepthStencilView;
+		VkFormat m_DepthFormat;
 
 		const bool* m_IsWindowClosing;
 
-		VkCommandPool m_CommandPool;
+		//one transient pool per frame in flight, reset wholesale
+		VkCommandPool* m_CommandPools;
 		VkCommandBuffer* m_CommandBuffers;
+		VkCommandPool m_OneShotCommandPool;
+		std::vector<VkCommandBuffer> m_FreeOneShotBuffers;
+		std::deque<std::pair<uint64_t, VkCommandBuffer>> m_PendingOneShotBuffers;
+		std::mutex m_OneShotMutex;
+		//indexed by frame * m_RecordingWorkers + worker
+		uint32_t m_RecordingWorkers = 0;
+		VkCommandPool* m_WorkerCommandPools = nullptr;
+		VkCommandBuffer* m_WorkerCommandBuffers = nullptr;
+		std::vector<uint8_t> m_WorkerRecorded;
+		//binary semaphores are only kept for the WSI, everything else waits on the timeline
 		VkSemaphore* m_ImageAvailableSemaphores;
 		VkSemaphore* m_RenderFinishedSemaphores;
-		VkFence* m_InFlightFences;
+		VkSemaphore m_TimelineSemaphore;
+		uint64_t m_TimelineValue = 0;
+		uint64_t* m_FrameTimelineValues;
+		//guards the graphics and present queues and the timeline counter
+		std::mutex m_QueueMutex;
 
 
 		uint32_t m_FramesInFlight;
 		uint32_t m_CurrentBufferIndex = 0;
 		uint32_t m_CurrentImageIndex;
 
+		//tagged with the timeline value of the next frame submit
+		std::vector<std::function<void()>> m_PendingDestruction;
+		std::deque<DeferredDestruction> m_DestructionQueue;
+
+		std::unique_ptr<VKMemoryAllocator> m_MemoryAllocator;
+
+		static const VkDeviceSize s_FrameAllocatorSize;
+		std::unique_ptr<VKFrameAllocator> m_FrameAllocator;
+		std::unique_ptr<VKDescriptorAllocator> m_DescriptorAllocator;
+		std::unique_ptr<VKBindlessHeap> m_BindlessHeap;
+
+		static const VkDeviceSize s_StagingRingSize;
+		std::unique_ptr<VKUploadManager> m_UploadManager;
+		uint64_t m_UploadWaitValue = 0;
+
 		VkViewport m_Viewport;
 		VkRect2D m_ScissorRect;
 
+		static const uint32_t s_MaxTimestampScopes;
+		bool m_TimestampsSupported = false;
+		float m_TimestampPeriod;
+		VkQueryPool* m_TimestampQueryPools;
+		std::vector<std::string>* m_TimestampNames;
+		//guards the names of the frame slot, open scopes are kept per recording thread
+		std::mutex m_TimestampMutex;
+		std::vector<GPUTimestampScope> m_GPUTimestamps;
+
+		static const uint32_t s_PipelineCacheMagic;
+		static const uint32_t s_PipelineCacheVersion;
+		VkPipelineCache m_PipelineCache;
+		std::unique_ptr<VKPipelineManifest> m_PipelineManifest;
+		bool m_CreationFeedback = false;
+		std::atomic<uint32_t> m_PipelineCacheHits = 0;
+		std::atomic<uint32_t> m_PipelineCacheMisses = 0;
+
+		static const char* s_ShaderObjectLayer;
 		std::vector<const char*> m_InstanceExtensions;
+		std::vector<const char*> m_InstanceLayers;
 
 		std::string m_GPUName;
 	};
@@ -0,0 +1,190 @@
+#include "VKDescriptorAllocator.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <functional>
+#include <stdexcept>
+
+const uint32_t SampleRender::VKDescriptorAllocator::s_InitialPoolSets = 64;
+const uint32_t SampleRender::VKDescriptorAllocator::s_MaxPoolSets = 4096;
+const std::vector<std::pair<VkDescriptorType, float>> SampleRender::VKDescriptorAllocator::s_PoolRatios =
+{
+    { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.0f },
+    { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 2.0f },
+    { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.0f },
+    { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1.0f },
+    { VK_DESCRIPTOR_TYPE_SAMPLER, 1.0f },
+    { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1.0f },
+};
+
+SampleRender::VKDescriptorAllocator::VKDescriptorAllocator(VKContext* context, uint32_t framesInFlight) :
+    m_Context(context)
+{
+    m_PersistentPools.NextPoolSets = s_InitialPoolSets;
+    m_FramePools.resize(framesInFlight);
+    for (auto& chain : m_FramePools)
+        chain.NextPoolSets = s_InitialPoolSets;
+    m_FrameCaches.resize(framesInFlight);
+}
+
+SampleRender::VKDescriptorAllocator::~VKDescriptorAllocator()
+{
+    //the owner idles the device first, destroying a pool frees every set in it
+    auto device = m_Context->GetDevice();
+    for (auto pool : m_PersistentPools.Pools)
+        vkDestroyDescriptorPool(device, pool, nullptr);
+    for (auto& chain : m_FramePools)
+        for (auto pool : chain.Pools)
+            vkDestroyDescriptorPool(device, pool, nullptr);
+}
+
+VkDescriptorSet SampleRender::VKDescriptorAllocator::Allocate(VkDescriptorSetLayout layout)
+{
+    std::lock_guard<std::mutex> lock(m_AllocatorMutex);
+    VkDescriptorSet set = AllocateFromChain(m_PersistentPools, layout, true);
+    m_PersistentOwners[set] = m_PersistentPools.Pools[m_PersistentPools.Current];
+    return set;
+}
+
+void SampleRender::VKDescriptorAllocator::Free(VkDescriptorSet set)
+{
+    std::lock_guard<std::mutex> lock(m_AllocatorMutex);
+    auto it = m_PersistentOwners.find(set);
+    assert(it != m_PersistentOwners.end());
+    vkFreeDescriptorSets(m_Context->GetDevice(), it->second, 1, &set);
+    m_PersistentOwners.erase(it);
+}
+
+void SampleRender::VKDescriptorAllocator::BeginFrame(uint32_t frameIndex)
+{
+    std::lock_guard<std::mutex> lock(m_AllocatorMutex);
+    m_FrameIndex = frameIndex;
+    PoolChain& chain = m_FramePools[m_FrameIndex];
+    for (auto pool : chain.Pools)
+        vkResetDescriptorPool(m_Context->GetDevice(), pool, 0);
+    chain.Current = 0;
+    m_FrameCaches[m_FrameIndex].clear();
+}
+
+VkDescriptorSet SampleRender::VKDescriptorAllocator::GetCachedSet(VkDescriptorSetLayout layout, const std::vector<VKDescriptorBinding>& bindings)
+{
+    std::lock_guard<std::mutex> lock(m_AllocatorMutex);
+    size_t hash = HashBindings(layout, bindings);
+    auto& candidates = m_FrameCaches[m_FrameIndex][hash];
+    for (const auto& candidate : candidates)
+    {
+        if ((candidate.Layout != layout) || (candidate.Bindings.size() != bindings.size()))
+            continue;
+        if (std::equal(bindings.begin(), bindings.end(), candidate.Bindings.begin(), IsSameBinding))
+            return candidate.Set;
+    }
+
+    VkDescriptorSet set = AllocateFromChain(m_FramePools[m_FrameIndex], layout, false);
+
+    std::vector<VkWriteDescriptorSet> descriptorWrites;
+    descriptorWrites.reserve(bindings.size());
+    for (const auto& binding : bindings)
+    {
+        VkWriteDescriptorSet descriptorWrite{};
+        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrite.dstSet = set;
+        descriptorWrite.dstBinding = binding.Binding;
+        descriptorWrite.dstArrayElement = 0;
+        descriptorWrite.descriptorType = binding.Type;
+        descriptorWrite.descriptorCount = 1;
+        bool isBuffer = (binding.Type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER) || (binding.Type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC) ||
+            (binding.Type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER) || (binding.Type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC);
+        if (isBuffer)
+            descriptorWrite.pBufferInfo = &binding.Buffer;
+        else
+            descriptorWrite.pImageInfo = &binding.Image;
+        descriptorWrites.push_back(descriptorWrite);
+    }
+    vkUpdateDescriptorSets(m_Context->GetDevice(), (uint32_t)descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
+
+    candidates.push_back({ layout, bindings, set });
+    return set;
+}
+
+VkDescriptorSet SampleRender::VKDescriptorAllocator::AllocateFromChain(PoolChain& chain, VkDescriptorSetLayout layout, bool freeable)
+{
+    auto device = m_Context->GetDevice();
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &layout;
+
+    VkDescriptorSet set;
+    //freed sets leave holes anywhere in a persistent chain, frame chains only fill up
+    for (size_t i = freeable ? 0 : chain.Current; i < chain.Pools.size(); i++)
+    {
+        allocInfo.descriptorPool = chain.Pools[i];
+        VkResult vkr = vkAllocateDescriptorSets(device, &allocInfo, &set);
+        if (vkr == VK_SUCCESS)
+        {
+            chain.Current = i;
+            return set;
+        }
+        assert((vkr == VK_ERROR_OUT_OF_POOL_MEMORY) || (vkr == VK_ERROR_FRAGMENTED_POOL));
+    }
+
+    chain.Pools.push_back(CreatePool(chain.NextPoolSets, freeable));
+    chain.Current = chain.Pools.size() - 1;
+    chain.NextPoolSets = std::min(chain.NextPoolSets * 2, s_MaxPoolSets);
+
+    allocInfo.descriptorPool = chain.Pools[chain.Current];
+    if (vkAllocateDescriptorSets(device, &allocInfo, &set) != VK_SUCCESS)
+        throw std::runtime_error("descriptor set layout does not fit in a descriptor pool!");
+    return set;
+}
+
+VkDescriptorPool SampleRender::VKDescriptorAllocator::CreatePool(uint32_t maxSets, bool freeable)
+{
+    VkResult vkr;
+    auto device = m_Context->GetDevice();
+
+    std::vector<VkDescriptorPoolSize> poolSizes;
+    for (const auto& ratio : s_PoolRatios)
+        poolSizes.push_back({ ratio.first, (uint32_t)std::ceil(ratio.second * maxSets) });
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = freeable ? VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT : 0;
+    poolInfo.poolSizeCount = (uint32_t)poolSizes.size();
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = maxSets;
+
+    VkDescriptorPool pool;
+    vkr = vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool);
+    assert(vkr == VK_SUCCESS);
+    return pool;
+}
+
+size_t SampleRender::VKDescriptorAllocator::HashBindings(VkDescriptorSetLayout layout, const std::vector<VKDescriptorBinding>& bindings)
+{
+    size_t hash = std::hash<uint64_t>()((uint64_t)layout);
+    auto combine = [&hash](uint64_t value)
+    {
+        hash ^= std::hash<uint64_t>()(value) + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+    };
+    for (const auto& binding : bindings)
+    {
+        combine(binding.Binding);
+        combine(binding.Type);
+        combine((uint64_t)binding.Buffer.buffer);
+        combine(binding.Buffer.offset);
+        combine(binding.Buffer.range);
+        combine((uint64_t)binding.Image.imageView);
+        combine((uint64_t)binding.Image.sampler);
+        combine(binding.Image.imageLayout);
+    }
+    return hash;
+}
+
+bool SampleRender::VKDescriptorAllocator::IsSameBinding(const VKDescriptorBinding& a, const VKDescriptorBinding& b)
+{
+    return (a.Binding == b.Binding) && (a.Type == b.Type) &&
+        (a.Buffer.buffer == b.Buffer.buffer) && (a.Buffer.offset == b.Buffer.offset) && (a.Buffer.range == b.Buffer.range) &&
+        (a.Image.imageView == b.Image.imageView) && (a.Image.sampler == b.Image.sampler) && (a.Image.imageLayout == b.Image.imageLayout);
+}
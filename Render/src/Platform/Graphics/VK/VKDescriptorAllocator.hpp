@@ -0,0 +1,72 @@
+#pragma once
+
+#include "VKContext.hpp"
+#include <vector>
+#include <mutex>
+#include <unordered_map>
+
+namespace SampleRender
+{
+	//One resource written into a cached set, Buffer or Image is read depending on Type
+	struct VKDescriptorBinding
+	{
+		uint32_t Binding = 0;
+		VkDescriptorType Type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		VkDescriptorBufferInfo Buffer{};
+		VkDescriptorImageInfo Image{};
+	};
+
+	class SAMPLE_RENDER_DLL_COMMAND VKDescriptorAllocator
+	{
+	public:
+		VKDescriptorAllocator(VKContext* context, uint32_t framesInFlight);
+		~VKDescriptorAllocator();
+
+		//Long lived sets, a new pool is chained when the current ones are full
+		VkDescriptorSet Allocate(VkDescriptorSetLayout layout);
+		//The caller defers it until the GPU is done with the set, usually through EnqueueDestruction
+		void Free(VkDescriptorSet set);
+
+		//Called once the frame slot has been released by the GPU, resets its pools in bulk and forgets its cached sets
+		void BeginFrame(uint32_t frameIndex);
+		//Frame set with the bindings written, valid until the frame slot comes back and never freed one by one
+		//The same layout and resources give back the same set within the frame
+		VkDescriptorSet GetCachedSet(VkDescriptorSetLayout layout, const std::vector<VKDescriptorBinding>& bindings);
+
+	private:
+		struct PoolChain
+		{
+			std::vector<VkDescriptorPool> Pools;
+			//the pools before it are full, frame chains only
+			size_t Current = 0;
+			uint32_t NextPoolSets;
+		};
+
+		struct CachedSet
+		{
+			VkDescriptorSetLayout Layout;
+			std::vector<VKDescriptorBinding> Bindings;
+			VkDescriptorSet Set;
+		};
+
+		VkDescriptorSet AllocateFromChain(PoolChain& chain, VkDescriptorSetLayout layout, bool freeable);
+		VkDescriptorPool CreatePool(uint32_t maxSets, bool freeable);
+		static size_t HashBindings(VkDescriptorSetLayout layout, const std::vector<VKDescriptorBinding>& bindings);
+		static bool IsSameBinding(const VKDescriptorBinding& a, const VKDescriptorBinding& b);
+
+		static const uint32_t s_InitialPoolSets;
+		static const uint32_t s_MaxPoolSets;
+		//descriptors of each type per set a pool is sized for
+		static const std::vector<std::pair<VkDescriptorType, float>> s_PoolRatios;
+
+		VKContext* m_Context;
+		std::mutex m_AllocatorMutex;
+
+		PoolChain m_PersistentPools;
+		std::unordered_map<VkDescriptorSet, VkDescriptorPool> m_PersistentOwners;
+
+		uint32_t m_FrameIndex = 0;
+		std::vector<PoolChain> m_FramePools;
+		std::vector<std::unordered_map<size_t, std::vector<CachedSet>>> m_FrameCaches;
+	};
+}
@@ -0,0 +1,66 @@
+#include "VKFrameAllocator.hpp"
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+SampleRender::VKFrameAllocator::VKFrameAllocator(VKContext* context, VkDeviceSize frameSize, uint32_t framesInFlight) :
+    m_Context(context)
+{
+    VkResult vkr;
+    auto device = m_Context->GetDevice();
+
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(m_Context->GetAdapter(), &deviceProperties);
+    m_Alignment = std::max<VkDeviceSize>(deviceProperties.limits.minUniformBufferOffsetAlignment, 16);
+    m_FrameSize = (frameSize + m_Alignment - 1) & ~(m_Alignment - 1);
+
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = m_FrameSize * framesInFlight;
+    bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    vkr = vkCreateBuffer(device, &bufferInfo, nullptr, &m_Buffer);
+    assert(vkr == VK_SUCCESS);
+
+    //on UMA and ReBAR devices the shaders read the CPU writes straight from video memory
+    VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    if (m_Context->GetMemoryAllocator()->SupportsDirectUploads())
+        properties |= VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    m_Memory = m_Context->GetMemoryAllocator()->AllocateBuffer(m_Buffer, properties);
+}
+
+SampleRender::VKFrameAllocator::~VKFrameAllocator()
+{
+    //the owner idles the device first
+    vkDestroyBuffer(m_Context->GetDevice(), m_Buffer, nullptr);
+    m_Context->GetMemoryAllocator()->Free(m_Memory);
+}
+
+void SampleRender::VKFrameAllocator::BeginFrame(uint32_t frameIndex)
+{
+    m_FrameBase = m_FrameSize * frameIndex;
+    m_Head = 0;
+    m_Epoch++;
+}
+
+uint8_t* SampleRender::VKFrameAllocator::Allocate(VkDeviceSize size, VkDeviceSize& offset)
+{
+    VkDeviceSize alignedSize = (size + m_Alignment - 1) & ~(m_Alignment - 1);
+    VkDeviceSize head = m_Head.fetch_add(alignedSize);
+    if ((head + alignedSize) > m_FrameSize)
+        throw std::runtime_error("frame allocator ran out of space!");
+
+    offset = m_FrameBase + head;
+    return m_Memory.MappedData + offset;
+}
+
+VkBuffer SampleRender::VKFrameAllocator::GetBuffer() const
+{
+    return m_Buffer;
+}
+
+uint64_t SampleRender::VKFrameAllocator::GetEpoch() const
+{
+    return m_Epoch;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "VKContext.hpp"
+#include <atomic>
+
+namespace SampleRender
+{
+	class SAMPLE_RENDER_DLL_COMMAND VKFrameAllocator
+	{
+	public:
+		//One persistently mapped buffer split in a region per frame in flight, usable as uniform, vertex and index data
+		VKFrameAllocator(VKContext* context, VkDeviceSize frameSize, uint32_t framesInFlight);
+		~VKFrameAllocator();
+
+		//Called once the frame slot has been released by the GPU, everything handed out for it becomes invalid
+		void BeginFrame(uint32_t frameIndex);
+		//Lock free, safe from the recording workers, offset is relative to GetBuffer()
+		uint8_t* Allocate(VkDeviceSize size, VkDeviceSize& offset);
+		VkBuffer GetBuffer() const;
+		//Bumped by BeginFrame, data written under an older epoch may already be overwritten
+		uint64_t GetEpoch() const;
+
+	private:
+		VKContext* m_Context;
+		VkBuffer m_Buffer;
+		VKAllocation m_Memory;
+		VkDeviceSize m_FrameSize;
+		//every allocation is rounded to it, so a single fetch_add keeps them aligned
+		VkDeviceSize m_Alignment;
+		VkDeviceSize m_FrameBase = 0;
+		std::atomic<VkDeviceSize> m_Head = 0;
+		std::atomic<uint64_t> m_Epoch = 0;
+	};
+}
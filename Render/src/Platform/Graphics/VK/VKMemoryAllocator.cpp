@@ -0,0 +1,461 @@
+#include "VKMemoryAllocator.hpp"
+#include "VKContext.hpp"
+#include <algorithm>
+#include <cassert>
+
+const VkDeviceSize SampleRender::VKMemoryAllocator::s_BlockSize = 64 << 20;
+const VkDeviceSize SampleRender::VKMemoryAllocator::s_MinAllocationSize = 256;
+
+SampleRender::VKMemoryAllocator::VKMemoryAllocator(VKContext* context) :
+    m_Context(context)
+{
+    vkGetPhysicalDeviceMemoryProperties(m_Context->GetAdapter(), &m_MemoryProperties);
+
+    //a host visible type on the largest device local heap, the 256MB BAR window of discrete cards is too small to hold every resource
+    const VkMemoryPropertyFlags directProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    VkDeviceSize largestDeviceHeap = 0;
+    for (uint32_t i = 0; i < m_MemoryProperties.memoryHeapCount; i++)
+        if (m_MemoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+            largestDeviceHeap = std::max(largestDeviceHeap, m_MemoryProperties.memoryHeaps[i].size);
+    for (uint32_t i = 0; i < m_MemoryProperties.memoryTypeCount; i++)
+    {
+        const VkMemoryType& memoryType = m_MemoryProperties.memoryTypes[i];
+        if (((memoryType.propertyFlags & directProperties) == directProperties) && (m_MemoryProperties.memoryHeaps[memoryType.heapIndex].size >= largestDeviceHeap))
+            m_DirectUploads = true;
+    }
+}
+
+SampleRender::VKMemoryAllocator::~VKMemoryAllocator()
+{
+    //the owner idles the device and releases every resource first
+    for (auto& pool : m_Pools)
+        for (auto& block : pool.second)
+            ReleaseBlock(block.get());
+}
+
+SampleRender::VKAllocation SampleRender::VKMemoryAllocator::AllocateBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties)
+{
+    VkResult vkr;
+    auto device = m_Context->GetDevice();
+
+    VkMemoryDedicatedRequirements dedicatedRequirements{};
+    dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+    VkMemoryRequirements2 memRequirements{};
+    memRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+    memRequirements.pNext = &dedicatedRequirements;
+
+    VkBufferMemoryRequirementsInfo2 requirementsInfo{};
+    requirementsInfo.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2;
+    requirementsInfo.buffer = buffer;
+    vkGetBufferMemoryRequirements2(device, &requirementsInfo, &memRequirements);
+
+    VkMemoryDedicatedAllocateInfo dedicatedInfo{};
+    dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+    dedicatedInfo.buffer = buffer;
+
+    bool dedicated = dedicatedRequirements.requiresDedicatedAllocation || dedicatedRequirements.prefersDedicatedAllocation;
+    VKAllocation allocation = Allocate(memRequirements.memoryRequirements, properties, dedicated, true, &dedicatedInfo);
+
+    vkr = vkBindBufferMemory(device, buffer, allocation.Memory, allocation.Offset);
+    assert(vkr == VK_SUCCESS);
+    return allocation;
+}
+
+SampleRender::VKAllocation SampleRender::VKMemoryAllocator::AllocateImage(VkImage image, VkMemoryPropertyFlags properties)
+{
+    VkResult vkr;
+    auto device = m_Context->GetDevice();
+
+    VkMemoryDedicatedRequirements dedicatedRequirements{};
+    dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+    VkMemoryRequirements2 memRequirements{};
+    memRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+    memRequirements.pNext = &dedicatedRequirements;
+
+    VkImageMemoryRequirementsInfo2 requirementsInfo{};
+    requirementsInfo.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+    requirementsInfo.image = image;
+    vkGetImageMemoryRequirements2(device, &requirementsInfo, &memRequirements);
+
+    VkMemoryDedicatedAllocateInfo dedicatedInfo{};
+    dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+    dedicatedInfo.image = image;
+
+    //render targets usually come back with prefersDedicatedAllocation
+    bool dedicated = dedicatedRequirements.requiresDedicatedAllocation || dedicatedRequirements.prefersDedicatedAllocation;
+    VKAllocation allocation = Allocate(memRequirements.memoryRequirements, properties, dedicated, false, &dedicatedInfo);
+
+    vkr = vkBindImageMemory(device, image, allocation.Memory, allocation.Offset);
+    assert(vkr == VK_SUCCESS);
+    return allocation;
+}
+
+void SampleRender::VKMemoryAllocator::Free(const VKAllocation& allocation)
+{
+    std::lock_guard<std::mutex> lock(m_AllocatorMutex);
+    if (allocation.Block == nullptr)
+    {
+        if (allocation.MappedData != nullptr)
+            vkUnmapMemory(m_Context->GetDevice(), allocation.Memory);
+        vkFreeMemory(m_Context->GetDevice(), allocation.Memory, nullptr);
+        m_DedicatedCount--;
+        m_DedicatedBytes -= allocation.Size;
+        return;
+    }
+
+    VKMemoryBlock* block = allocation.Block;
+    block->Relocatables.erase(allocation.Offset);
+    FreeToBlock(block, allocation.Offset, allocation.Order);
+
+    //one empty block stays around per pool, so a resource recreated every frame does not hit vkAllocateMemory
+    auto& blocks = m_Pools[allocation.Pool];
+    if ((block->FreeBytes == block->Size) && (blocks.size() > 1))
+    {
+        ReleaseBlock(block);
+        blocks.erase(std::find_if(blocks.begin(), blocks.end(), [block](const std::unique_ptr<VKMemoryBlock>& candidate)
+        {
+            return candidate.get() == block;
+        }));
+    }
+}
+
+void SampleRender::VKMemoryAllocator::SetRelocatable(const VKAllocation& allocation, VKRelocatable* owner)
+{
+    if (allocation.Block == nullptr)
+        return;
+    std::lock_guard<std::mutex> lock(m_AllocatorMutex);
+    allocation.Block->Relocatables[allocation.Offset] = std::make_pair(allocation, owner);
+}
+
+void SampleRender::VKMemoryAllocator::ClearRelocatable(const VKAllocation& allocation)
+{
+    if (allocation.Block == nullptr)
+        return;
+    std::lock_guard<std::mutex> lock(m_AllocatorMutex);
+    allocation.Block->Relocatables.erase(allocation.Offset);
+}
+
+VkDeviceSize SampleRender::VKMemoryAllocator::Defragment(VkDeviceSize budget, bool gpuIdle, uint64_t completedUpload)
+{
+    std::lock_guard<std::mutex> lock(m_AllocatorMutex);
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    VkDeviceSize moved = 0;
+
+    for (auto& pool : m_Pools)
+    {
+        auto& blocks = pool.second;
+        if (blocks.size() < 2)
+            continue;
+
+        //only blocks holding nothing but movable ranges can be emptied, the others would bounce ranges between blocks
+        VKMemoryBlock* source = nullptr;
+        for (auto& block : blocks)
+        {
+            VkDeviceSize relocatableBytes = 0;
+            for (auto& relocatable : block->Relocatables)
+                relocatableBytes += relocatable.second.first.Size;
+            if (block->Relocatables.empty() || (relocatableBytes != (block->Size - block->FreeBytes)))
+                continue;
+            if ((source == nullptr) || (block->FreeBytes > source->FreeBytes))
+                source = block.get();
+        }
+        if (source == nullptr)
+            continue;
+
+        //fullest blocks first, so the free space ends up in as few blocks as possible
+        std::vector<VKMemoryBlock*> targets;
+        VkDeviceSize targetFreeBytes = 0;
+        for (auto& block : blocks)
+        {
+            if (block.get() == source)
+                continue;
+            targets.push_back(block.get());
+            targetFreeBytes += block->FreeBytes;
+        }
+        //the block could not be emptied, moving part of it only shuffles the holes around
+        if (targetFreeBytes < (source->Size - source->FreeBytes))
+            continue;
+        std::sort(targets.begin(), targets.end(), [](const VKMemoryBlock* a, const VKMemoryBlock* b)
+        {
+            return a->FreeBytes < b->FreeBytes;
+        });
+
+        std::vector<std::pair<VKAllocation, VKRelocatable*>> relocatables;
+        for (auto& relocatable : source->Relocatables)
+            relocatables.push_back(relocatable.second);
+
+        for (auto& relocatable : relocatables)
+        {
+            const VKAllocation& oldMemory = relocatable.first;
+            if ((moved + oldMemory.Size) > budget)
+                break;
+            if (!relocatable.second->CanRelocate(gpuIdle, completedUpload))
+                continue;
+
+            VKAllocation newMemory = oldMemory;
+            newMemory.Block = nullptr;
+            for (auto target : targets)
+            {
+                if ((target->FreeBytes >= oldMemory.Size) && AllocateFromBlock(target, oldMemory.Order, newMemory.Offset))
+                {
+                    newMemory.Block = target;
+                    break;
+                }
+            }
+            if (newMemory.Block == nullptr)
+                continue;
+            newMemory.Memory = newMemory.Block->Memory;
+            newMemory.MappedData = (newMemory.Block->MappedData != nullptr) ? newMemory.Block->MappedData + newMemory.Offset : nullptr;
+
+            if (commandBuffer == VK_NULL_HANDLE)
+                commandBuffer = m_Context->BeginOneShotCommands();
+            source->Relocatables.erase(oldMemory.Offset);
+            relocatable.second->Relocate(commandBuffer, oldMemory, newMemory);
+            newMemory.Block->Relocatables[newMemory.Offset] = std::make_pair(newMemory, relocatable.second);
+            moved += oldMemory.Size;
+        }
+    }
+
+    if (commandBuffer != VK_NULL_HANDLE)
+    {
+        //each Relocate records the barriers of its own copy, the next frames follow on the same queue
+        m_Context->SubmitOneShotCommands(commandBuffer);
+        m_RelocatedBytes += moved;
+    }
+    return moved;
+}
+
+SampleRender::GPUMemoryStatistics SampleRender::VKMemoryAllocator::GetStatistics()
+{
+    std::lock_guard<std::mutex> lock(m_AllocatorMutex);
+    GPUMemoryStatistics statistics;
+    VkDeviceSize freeBytes = 0;
+    for (auto& pool : m_Pools)
+    {
+        for (auto& block : pool.second)
+        {
+            statistics.ReservedBytes += block->Size;
+            freeBytes += block->FreeBytes;
+            for (uint32_t order = (uint32_t)block->FreeLists.size(); order > 0; order--)
+            {
+                if (!block->FreeLists[order - 1].empty())
+                {
+                    statistics.LargestFreeRange = std::max<uint64_t>(statistics.LargestFreeRange, s_MinAllocationSize << (order - 1));
+                    break;
+                }
+            }
+            statistics.DeviceMemoryCount++;
+        }
+    }
+    statistics.AllocatedBytes = statistics.ReservedBytes - freeBytes + m_DedicatedBytes;
+    statistics.ReservedBytes += m_DedicatedBytes;
+    statistics.DeviceMemoryCount += m_DedicatedCount;
+    if (freeBytes > 0)
+        statistics.Fragmentation = 1.0f - ((float)statistics.LargestFreeRange / (float)freeBytes);
+    statistics.RelocatedBytes = m_RelocatedBytes;
+    return statistics;
+}
+
+SampleRender::VKAllocation SampleRender::VKMemoryAllocator::Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool dedicated, bool linear, const VkMemoryDedicatedAllocateInfo* dedicatedInfo)
+{
+    std::lock_guard<std::mutex> lock(m_AllocatorMutex);
+    uint32_t memoryType = FindMemoryType(requirements.memoryTypeBits, properties);
+    VkDeviceSize blockSize = GetBlockSize(memoryType);
+    VkDeviceSize size = std::max(requirements.size, requirements.alignment);
+
+    //past half a block the buddy rounding wastes more than it saves
+    if (dedicated || (size > (blockSize >> 1)))
+        return AllocateDedicated(requirements, memoryType, dedicatedInfo);
+
+    //a buddy range of order n sits on a multiple of its own size, which covers the alignment
+    uint32_t order = GetOrder(size);
+    uint32_t poolKey = memoryType * 2 + (linear ? 0 : 1);
+    auto& blocks = m_Pools[poolKey];
+
+    VKAllocation allocation;
+    allocation.Pool = poolKey;
+    allocation.Order = order;
+    allocation.Size = s_MinAllocationSize << order;
+
+    for (auto& block : blocks)
+    {
+        if ((block->FreeBytes >= allocation.Size) && AllocateFromBlock(block.get(), order, allocation.Offset))
+        {
+            allocation.Block = block.get();
+            break;
+        }
+    }
+
+    if (allocation.Block == nullptr)
+    {
+        blocks.emplace_back(CreateBlock(memoryType));
+        allocation.Block = blocks.back().get();
+        bool allocated = AllocateFromBlock(allocation.Block, order, allocation.Offset);
+        assert(allocated);
+    }
+
+    allocation.Memory = allocation.Block->Memory;
+    if (allocation.Block->MappedData != nullptr)
+        allocation.MappedData = allocation.Block->MappedData + allocation.Offset;
+    return allocation;
+}
+
+SampleRender::VKAllocation SampleRender::VKMemoryAllocator::AllocateDedicated(const VkMemoryRequirements& requirements, uint32_t memoryType, const VkMemoryDedicatedAllocateInfo* dedicatedInfo)
+{
+    VkResult vkr;
+    auto device = m_Context->GetDevice();
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.pNext = dedicatedInfo;
+    allocInfo.allocationSize = requirements.size;
+    allocInfo.memoryTypeIndex = memoryType;
+
+    VKAllocation allocation;
+    allocation.Size = requirements.size;
+    vkr = vkAllocateMemory(device, &allocInfo, nullptr, &allocation.Memory);
+    assert(vkr == VK_SUCCESS);
+
+    if (IsHostVisible(memoryType))
+    {
+        void* mappedData = nullptr;
+        vkr = vkMapMemory(device, allocation.Memory, 0, VK_WHOLE_SIZE, 0, &mappedData);
+        assert(vkr == VK_SUCCESS);
+        allocation.MappedData = (uint8_t*)mappedData;
+    }
+    m_DedicatedCount++;
+    m_DedicatedBytes += allocation.Size;
+    return allocation;
+}
+
+SampleRender::VKMemoryBlock* SampleRender::VKMemoryAllocator::CreateBlock(uint32_t memoryType)
+{
+    VkResult vkr;
+    auto device = m_Context->GetDevice();
+
+    VKMemoryBlock* block = new VKMemoryBlock();
+    block->Size = GetBlockSize(memoryType);
+    block->FreeBytes = block->Size;
+    block->MappedData = nullptr;
+    block->FreeLists.resize(GetMaxOrder(block->Size) + 1);
+    block->FreeLists.back().insert(0);
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = block->Size;
+    allocInfo.memoryTypeIndex = memoryType;
+
+    vkr = vkAllocateMemory(device, &allocInfo, nullptr, &block->Memory);
+    assert(vkr == VK_SUCCESS);
+
+    if (IsHostVisible(memoryType))
+    {
+        void* mappedData = nullptr;
+        vkr = vkMapMemory(device, block->Memory, 0, VK_WHOLE_SIZE, 0, &mappedData);
+        assert(vkr == VK_SUCCESS);
+        block->MappedData = (uint8_t*)mappedData;
+    }
+    return block;
+}
+
+void SampleRender::VKMemoryAllocator::ReleaseBlock(VKMemoryBlock* block)
+{
+    auto device = m_Context->GetDevice();
+    if (block->MappedData != nullptr)
+        vkUnmapMemory(device, block->Memory);
+    vkFreeMemory(device, block->Memory, nullptr);
+}
+
+bool SampleRender::VKMemoryAllocator::AllocateFromBlock(VKMemoryBlock* block, uint32_t order, VkDeviceSize& offset)
+{
+    uint32_t maxOrder = (uint32_t)block->FreeLists.size() - 1;
+    if (order > maxOrder)
+        return false;
+
+    uint32_t current = order;
+    while ((current <= maxOrder) && block->FreeLists[current].empty())
+        current++;
+    if (current > maxOrder)
+        return false;
+
+    offset = *block->FreeLists[current].begin();
+    block->FreeLists[current].erase(block->FreeLists[current].begin());
+    //splits the range, the upper halves go back to the free lists
+    while (current > order)
+    {
+        current--;
+        block->FreeLists[current].insert(offset + (s_MinAllocationSize << current));
+    }
+    block->FreeBytes -= s_MinAllocationSize << order;
+    return true;
+}
+
+void SampleRender::VKMemoryAllocator::FreeToBlock(VKMemoryBlock* block, VkDeviceSize offset, uint32_t order)
+{
+    uint32_t maxOrder = (uint32_t)block->FreeLists.size() - 1;
+    block->FreeBytes += s_MinAllocationSize << order;
+    //merges with the buddy while it is free
+    while (order < maxOrder)
+    {
+        VkDeviceSize buddy = offset ^ (s_MinAllocationSize << order);
+        if (block->FreeLists[order].erase(buddy) == 0)
+            break;
+        offset = std::min(offset, buddy);
+        order++;
+    }
+    block->FreeLists[order].insert(offset);
+}
+
+uint32_t SampleRender::VKMemoryAllocator::GetOrder(VkDeviceSize size) const
+{
+    uint32_t order = 0;
+    while ((s_MinAllocationSize << order) < size)
+        order++;
+    return order;
+}
+
+uint32_t SampleRender::VKMemoryAllocator::GetMaxOrder(VkDeviceSize blockSize) const
+{
+    return GetOrder(blockSize);
+}
+
+VkDeviceSize SampleRender::VKMemoryAllocator::GetBlockSize(uint32_t memoryType) const
+{
+    //small heaps, like the 256MB BAR window, get smaller blocks so one pool cannot take the whole heap
+    VkDeviceSize heapSize = m_MemoryProperties.memoryHeaps[m_MemoryProperties.memoryTypes[memoryType].heapIndex].size;
+    VkDeviceSize blockSize = s_BlockSize;
+    while ((blockSize > s_MinAllocationSize) && (blockSize > (heapSize >> 3)))
+        blockSize >>= 1;
+    return blockSize;
+}
+
+uint32_t SampleRender::VKMemoryAllocator::FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const
+{
+    for (uint32_t i = 0; i < m_MemoryProperties.memoryTypeCount; i++) {
+        if ((typeFilter & (1 << i)) && (m_MemoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+
+    assert(false);
+    return 0xffffffffu;
+}
+
+bool SampleRender::VKMemoryAllocator::SupportsDirectUploads() const
+{
+    return m_DirectUploads;
+}
+
+VkMemoryPropertyFlags SampleRender::VKMemoryAllocator::GetDeviceLocalProperties() const
+{
+    if (m_DirectUploads)
+        return VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    return VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+}
+
+bool SampleRender::VKMemoryAllocator::IsHostVisible(uint32_t memoryType) const
+{
+    return (m_MemoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "RenderDLLMacro.hpp"
+#include "GraphicsContext.hpp"
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <set>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace SampleRender
+{
+	class VKContext;
+	struct VKAllocation;
+
+	//Owner of a device local resource the allocator may move to compact its blocks
+	class SAMPLE_RENDER_DLL_COMMAND VKRelocatable
+	{
+	public:
+		virtual ~VKRelocatable() = default;
+
+		//gpuIdle is true when no frame in flight can reference the resource, which descriptor rewrites need
+		//Uploads with a ticket up to completedUpload are done, it runs under the allocator lock and must not ask the upload manager
+		virtual bool CanRelocate(bool gpuIdle, uint64_t completedUpload) const = 0;
+		//Creates the resource again bound to newMemory, records the copy with the barriers around it and retires the old resource and memory through EnqueueDestruction
+		//Runs under the allocator lock, it must not call back into the allocator
+		virtual void Relocate(VkCommandBuffer commandBuffer, const VKAllocation& oldMemory, const VKAllocation& newMemory) = 0;
+	};
+
+	struct VKMemoryBlock;
+
+	struct VKAllocation
+	{
+		VkDeviceMemory Memory = VK_NULL_HANDLE;
+		VkDeviceSize Offset = 0;
+		//size of the buddy range, at least the requested size
+		VkDeviceSize Size = 0;
+		//null unless the memory type is host visible
+		uint8_t* MappedData = nullptr;
+		//null for dedicated allocations
+		VKMemoryBlock* Block = nullptr;
+		uint32_t Pool = 0;
+		uint32_t Order = 0;
+	};
+
+	struct VKMemoryBlock
+	{
+		VkDeviceMemory Memory;
+		VkDeviceSize Size;
+		//persistently mapped when the memory type is host visible
+		uint8_t* MappedData;
+		VkDeviceSize FreeBytes;
+		//free offsets per buddy order, order 0 is the minimum allocation size
+		std::vector<std::set<VkDeviceSize>> FreeLists;
+		//ranges defragmentation may move, by offset
+		std::unordered_map<VkDeviceSize, std::pair<VKAllocation, VKRelocatable*>> Relocatables;
+	};
+
+	class SAMPLE_RENDER_DLL_COMMAND VKMemoryAllocator
+	{
+	public:
+		VKMemoryAllocator(VKContext* context);
+		~VKMemoryAllocator();
+
+		//Both allocate and bind, big resources and those the driver asks for get a dedicated allocation
+		VKAllocation AllocateBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties);
+		VKAllocation AllocateImage(VkImage image, VkMemoryPropertyFlags properties);
+		//The caller defers it until the GPU is done with the resource, usually through EnqueueDestruction
+		void Free(const VKAllocation& allocation);
+
+		//Dedicated allocations are never moved, the owner clears the entry before it retires the resource
+		void SetRelocatable(const VKAllocation& allocation, VKRelocatable* owner);
+		void ClearRelocatable(const VKAllocation& allocation);
+		//Evacuates the sparsest block of each pool into the fuller ones, up to budget bytes
+		//The copies are submitted on a one-shot buffer, ahead of the next frame, returns the bytes moved
+		VkDeviceSize Defragment(VkDeviceSize budget, bool gpuIdle, uint64_t completedUpload);
+
+		GPUMemoryStatistics GetStatistics();
+
+		//True on UMA and full ReBAR devices, where all of the video memory is also host visible
+		bool SupportsDirectUploads() const;
+		//Properties for long lived resources, host visible too when the CPU can write the final memory without staging
+		VkMemoryPropertyFlags GetDeviceLocalProperties() const;
+
+	private:
+		VKAllocation Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool dedicated, bool linear, const VkMemoryDedicatedAllocateInfo* dedicatedInfo);
+		VKAllocation AllocateDedicated(const VkMemoryRequirements& requirements, uint32_t memoryType, const VkMemoryDedicatedAllocateInfo* dedicatedInfo);
+		VKMemoryBlock* CreateBlock(uint32_t memoryType);
+		void ReleaseBlock(VKMemoryBlock* block);
+
+		bool AllocateFromBlock(VKMemoryBlock* block, uint32_t order, VkDeviceSize& offset);
+		void FreeToBlock(VKMemoryBlock* block, VkDeviceSize offset, uint32_t order);
+		uint32_t GetOrder(VkDeviceSize size) const;
+		uint32_t GetMaxOrder(VkDeviceSize blockSize) const;
+		VkDeviceSize GetBlockSize(uint32_t memoryType) const;
+		uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+		bool IsHostVisible(uint32_t memoryType) const;
+
+		static const VkDeviceSize s_BlockSize;
+		static const VkDeviceSize s_MinAllocationSize;
+
+		VKContext* m_Context;
+		std::mutex m_AllocatorMutex;
+		VkPhysicalDeviceMemoryProperties m_MemoryProperties;
+		bool m_DirectUploads = false;
+
+		//buffers and optimal images never share a block, so bufferImageGranularity can be ignored
+		//the pool key is memoryType * 2 + (linear ? 0 : 1)
+		std::unordered_map<uint32_t, std::vector<std::unique_ptr<VKMemoryBlock>>> m_Pools;
+		uint32_t m_DedicatedCount = 0;
+		VkDeviceSize m_DedicatedBytes = 0;
+		VkDeviceSize m_RelocatedBytes = 0;
+	};
+}
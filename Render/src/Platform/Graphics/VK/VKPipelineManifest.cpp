@@ -0,0 +1,65 @@
+#include "VKPipelineManifest.hpp"
+#include "FileHandler.hpp"
+#include "Console.hpp"
+
+SampleRender::VKPipelineManifest::VKPipelineManifest(std::string_view path, bool record) :
+    m_Path(path), m_Recording(record && !path.empty())
+{
+    m_Recorded = Json::Value(Json::arrayValue);
+    m_Loaded = Json::Value(Json::arrayValue);
+
+    if (m_Path.empty() || !FileHandler::FileExists(m_Path))
+        return;
+
+    std::string jsonResult;
+    Json::Reader reader;
+    Json::Value manifest;
+    if (!FileHandler::ReadTextFile(m_Path, &jsonResult) || !reader.parse(jsonResult, manifest) || !manifest["Pipelines"].isArray())
+    {
+        Console::CoreWarn("Pipeline manifest {} is not readable, skipping warm-up", m_Path);
+        return;
+    }
+    m_Loaded = manifest["Pipelines"];
+
+    //a new recording keeps what the previous sessions found
+    if (m_Recording)
+    {
+        for (auto& entry : m_Loaded)
+            Record(entry);
+    }
+}
+
+void SampleRender::VKPipelineManifest::Record(const Json::Value& entry)
+{
+    if (!m_Recording)
+        return;
+
+    Json::StreamWriterBuilder builder;
+    builder["indentation"] = "";
+    std::string key = Json::writeString(builder, entry);
+    std::lock_guard<std::mutex> lock(m_RecordMutex);
+    if (m_RecordedKeys.insert(key).second)
+        m_Recorded.append(entry);
+}
+
+void SampleRender::VKPipelineManifest::Save()
+{
+    if (!m_Recording)
+        return;
+
+    Json::Value manifest;
+    Json::StreamWriterBuilder builder;
+    {
+        std::lock_guard<std::mutex> lock(m_RecordMutex);
+        manifest["Pipelines"] = m_Recorded;
+    }
+    if (FileHandler::WriteTextFile(m_Path, Json::writeString(builder, manifest)))
+        Console::CoreLog("Recorded {} pipelines into {}", manifest["Pipelines"].size(), m_Path);
+    else
+        Console::CoreWarn("Failed to write pipeline manifest {}", m_Path);
+}
+
+const Json::Value& SampleRender::VKPipelineManifest::GetEntries() const
+{
+    return m_Loaded;
+}
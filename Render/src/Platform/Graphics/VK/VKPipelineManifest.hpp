@@ -0,0 +1,32 @@
+#pragma once
+
+#include "RenderDLLMacro.hpp"
+#include <json/json.h>
+#include <string>
+#include <unordered_set>
+#include <mutex>
+
+namespace SampleRender
+{
+	//Every pipeline permutation built in a session, replayed into the pipeline cache on the next startup
+	class SAMPLE_RENDER_DLL_COMMAND VKPipelineManifest
+	{
+	public:
+		VKPipelineManifest(std::string_view path, bool record);
+
+		//Safe to call from shader build workers, duplicates are dropped
+		void Record(const Json::Value& entry);
+		void Save();
+
+		//Entries read at startup
+		const Json::Value& GetEntries() const;
+
+	private:
+		std::string m_Path;
+		bool m_Recording;
+		std::mutex m_RecordMutex;
+		std::unordered_set<std::string> m_RecordedKeys;
+		Json::Value m_Recorded;
+		Json::Value m_Loaded;
+	};
+}
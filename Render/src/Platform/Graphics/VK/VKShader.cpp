@@ -1,7 +1,15 @@
 #include "VKShader.hpp"
+#include "VKUploadManager.hpp"
+#include "VKFrameAllocator.hpp"
+#include "VKDescriptorAllocator.hpp"
+#include "VKBindlessHeap.hpp"
+#include "VKPipelineManifest.hpp"
 #include "FileHandler.hpp"
+#include "Console.hpp"
 #include <filesystem>
 #include <cstdlib>
+#include <algorithm>
+#include <array>
 
 namespace fs = std::filesystem;
 
@@ -11,6 +19,12 @@ const std::list<std::string> SampleRender::VKShader::s_GraphicsPipelineStages =
     "ps"
 };
 
+const std::vector<VkDynamicState> SampleRender::VKShader::s_DynamicStates =
+{
+    VK_DYNAMIC_STATE_VIEWPORT,
+    VK_DYNAMIC_STATE_SCISSOR
+};
+
 const std::unordered_map<std::string, VkShaderStageFlagBits> SampleRender::VKShader::s_StageCaster =
 {
     {"vs", VK_SHADER_STAGE_VERTEX_BIT},
@@ -30,19 +44,94 @@ const std::unordered_map<uint32_t, VkShaderStageFlagBits> SampleRender::VKShader
     {AllowedStages::AMPLIFICATION_STAGE, VK_SHADER_STAGE_TASK_BIT_EXT},
 };
 
-SampleRender::VKShader::VKShader(const std::shared_ptr<VKContext>* context, std::string json_controller_path, InputBufferLayout layout, SmallBufferLayout smallBufferLayout, UniformLayout uniformLayout, TextureLayout textureLayout, SamplerLayout samplerLayout) :
+SampleRender::VKShader::VKShader(const std::shared_ptr<VKContext>* context, std::string json_controller_path, InputBufferLayout layout, SmallBufferLayout smallBufferLayout, UniformLayout uniformLayout, TextureLayout textureLayout, SamplerLayout samplerLayout, ThreadPool* buildPool) :
 	m_Context(context), m_Layout(layout), m_SmallBufferLayout(smallBufferLayout), m_UniformLayout(uniformLayout), m_TextureLayout(textureLayout), m_SamplerLayout(samplerLayout)
+{
+    if (buildPool == nullptr)
+        Build(json_controller_path);
+    else
+        m_Build = buildPool->Enqueue([this, json_controller_path]() { Build(json_controller_path); });
+}
+
+SampleRender::VKShader::~VKShader()
+{
+    //the worker still owns the members until the build returns, a failed build leaves m_Built false and some handles null
+    if (m_Build.valid())
+    {
+        try
+        {
+            m_Build.get();
+        }
+        catch (const std::exception& e)
+        {
+            Console::CoreError("Shader build failed: {}", e.what());
+        }
+    }
+
+    auto device = (*m_Context)->GetDevice();
+    auto destroyShader = (*m_Context)->GetShaderObjectDispatch().DestroyShader;
+    VKMemoryAllocator* allocator = (*m_Context)->GetMemoryAllocator();
+    VKDescriptorAllocator* descriptorAllocator = (*m_Context)->GetDescriptorAllocator();
+    VKBindlessHeap* bindlessHeap = (*m_Context)->GetBindlessHeap();
+    for (auto& i : m_Textures)
+        if (i.second.Memory.Memory != VK_NULL_HANDLE)
+            allocator->ClearRelocatable(i.second.Memory);
+
+    (*m_Context)->EnqueueDestruction([device, allocator, textures = m_Textures, samplers = m_Samplers,
+        descriptorAllocator, descriptorSets = m_DescriptorSets, bindlessHeap, samplerIndices = m_SamplerIndices, rootSignature = m_RootSignature, pipeline = m_GraphicsPipeline, pipelineLayout = m_PipelineLayout,
+        shaderObjects = m_ShaderObjects, destroyShader, modules = m_Modules]()
+    {
+        for (auto& i : textures)
+        {
+            if (i.second.View != VK_NULL_HANDLE)
+                vkDestroyImageView(device, i.second.View, nullptr);
+            if (i.second.Resource != VK_NULL_HANDLE)
+                vkDestroyImage(device, i.second.Resource, nullptr);
+            if (i.second.Memory.Memory != VK_NULL_HANDLE)
+                allocator->Free(i.second.Memory);
+            if ((bindlessHeap != nullptr) && (i.second.BindlessIndex != UINT32_MAX))
+                bindlessHeap->ReleaseTexture(i.second.BindlessIndex);
+        }
+        if (bindlessHeap != nullptr)
+            for (auto& i : samplerIndices)
+                bindlessHeap->ReleaseSampler(i.second);
+
+        for (auto& i : samplers)
+        {
+            if (i.second != VK_NULL_HANDLE)
+                vkDestroySampler(device, i.second, nullptr);
+        }
+        for (auto& i : descriptorSets)
+            if (i.second != VK_NULL_HANDLE)
+                descriptorAllocator->Free(i.second);
+        //a build that failed before the pipeline was created still holds its modules
+        for (auto& i : modules)
+            if (i.second != VK_NULL_HANDLE)
+                vkDestroyShaderModule(device, i.second, nullptr);
+        if (rootSignature != VK_NULL_HANDLE)
+            vkDestroyDescriptorSetLayout(device, rootSignature, nullptr);
+        if (pipeline != VK_NULL_HANDLE)
+            vkDestroyPipeline(device, pipeline, nullptr);
+        for (auto shaderObject : shaderObjects)
+            if (shaderObject != VK_NULL_HANDLE)
+                destroyShader(device, shaderObject, nullptr);
+        if (pipelineLayout != VK_NULL_HANDLE)
+            vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+    });
+}
+
+void SampleRender::VKShader::Build(std::string json_controller_path)
 {
     VkResult vkr;
     auto device = (*m_Context)->GetDevice();
     auto renderPass = (*m_Context)->GetRenderPass();
 
     InitJsonAndPaths(json_controller_path);
-    CreateCopyPipeline();
 
+    bool shaderObjects = (*m_Context)->IsShaderObjectEnabled();
     std::vector<VkPipelineShaderStageCreateInfo> shaderStages;
 
-    for (auto it = s_GraphicsPipelineStages.begin(); it != s_GraphicsPipelineStages.end(); it++)
+    for (auto it = s_GraphicsPipelineStages.begin(); (it != s_GraphicsPipelineStages.end()) && !shaderObjects; it++)
     {
         VkPipelineShaderStageCreateInfo pipelineStage;
         PushShader(*it, &pipelineStage);
@@ -52,25 +141,30 @@ SampleRender::VKShader::VKShader(const std::shared_ptr<VKContext>* context, std:
     VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
     vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 
-    VkVertexInputBindingDescription bindingDescription{};
-    bindingDescription.binding = 0;
-    bindingDescription.stride = m_Layout.GetStride();
-    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    std::vector<VkVertexInputBindingDescription> bindingDescriptions;
+    for (auto& slot : m_Layout.GetBufferSlots())
+    {
+        VkVertexInputBindingDescription bindingDescription{};
+        bindingDescription.binding = slot.Slot;
+        bindingDescription.stride = slot.Stride;
+        bindingDescription.inputRate = GetNativeInputRate(slot.Rate);
+        bindingDescriptions.push_back(bindingDescription);
+    }
 
     auto nativeElements = m_Layout.GetElements();
     VkVertexInputAttributeDescription* ied = new VkVertexInputAttributeDescription[nativeElements.size()];
 
     for (size_t i = 0; i < nativeElements.size(); i++)
     {
-        ied[i].binding = 0;
+        ied[i].binding = nativeElements[i].GetBufferSlot();
         ied[i].location = i;
         ied[i].format = GetNativeFormat(nativeElements[i].GetType());
         ied[i].offset = nativeElements[i].GetOffset();
     }
 
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
+    vertexInputInfo.vertexBindingDescriptionCount = (uint32_t)bindingDescriptions.size();
     vertexInputInfo.vertexAttributeDescriptionCount = m_Layout.GetElements().size();
-    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+    vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
     vertexInputInfo.pVertexAttributeDescriptions = ied;
 
     VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
@@ -85,8 +179,8 @@ SampleRender::VKShader::VKShader(const std::shared_ptr<VKContext>* context, std:
     SetRasterizer(&rasterizer);
     SetBlend(&colorBlendAttachment, &colorBlending);
     SetDepthStencil(&depthStencil);
-    CreateDescriptorPool();
-    CreateDescriptorSetLayout();
+    std::vector<VkDescriptorSetLayoutBinding> setBindings;
+    CreateDescriptorSetLayout(&setBindings);
     
     {
         PreallocatesDescSets();
@@ -116,14 +210,10 @@ SampleRender::VKShader::VKShader(const std::shared_ptr<VKContext>* context, std:
         CreateDescriptorSets();
     }
 
-    std::vector<VkDynamicState> dynamicStates = {
-        VK_DYNAMIC_STATE_VIEWPORT,
-        VK_DYNAMIC_STATE_SCISSOR
-    };
     VkPipelineDynamicStateCreateInfo dynamicState{};
     dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-    dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
-    dynamicState.pDynamicStates = dynamicStates.data();
+    dynamicState.dynamicStateCount = static_cast<uint32_t>(s_DynamicStates.size());
+    dynamicState.pDynamicStates = s_DynamicStates.data();
 
     VkPushConstantRange pushConstantRange{};
     
@@ -140,14 +230,46 @@ SampleRender::VKShader::VKShader(const std::shared_ptr<VKContext>* context, std:
 
     VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = 1;
-    pipelineLayoutInfo.pSetLayouts = &m_RootSignature;
+    std::vector<VkDescriptorSetLayout> setLayouts = GetSetLayouts();
+    pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+    pipelineLayoutInfo.pSetLayouts = setLayouts.data();
     pipelineLayoutInfo.pushConstantRangeCount = 1;
     pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
     vkr = vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &m_PipelineLayout);
     assert(vkr == VK_SUCCESS);
 
+    if (shaderObjects)
+    {
+        CreateShaderObjects(pushConstantRange);
+
+        for (auto& bindingDescription : bindingDescriptions)
+        {
+            VkVertexInputBindingDescription2EXT vertexBinding{};
+            vertexBinding.sType = VK_STRUCTURE_TYPE_VERTEX_INPUT_BINDING_DESCRIPTION_2_EXT;
+            vertexBinding.binding = bindingDescription.binding;
+            vertexBinding.stride = bindingDescription.stride;
+            vertexBinding.inputRate = bindingDescription.inputRate;
+            vertexBinding.divisor = 1;
+            m_VertexBindings.push_back(vertexBinding);
+        }
+
+        for (size_t i = 0; i < nativeElements.size(); i++)
+        {
+            VkVertexInputAttributeDescription2EXT vertexAttribute{};
+            vertexAttribute.sType = VK_STRUCTURE_TYPE_VERTEX_INPUT_ATTRIBUTE_DESCRIPTION_2_EXT;
+            vertexAttribute.location = ied[i].location;
+            vertexAttribute.binding = ied[i].binding;
+            vertexAttribute.format = ied[i].format;
+            vertexAttribute.offset = ied[i].offset;
+            m_VertexAttributes.push_back(vertexAttribute);
+        }
+
+        delete[] ied;
+        m_Built = true;
+        return;
+    }
+
     VkGraphicsPipelineCreateInfo pipelineInfo{};
     pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
     pipelineInfo.stageCount = (uint32_t)shaderStages.size();
@@ -165,52 +287,90 @@ SampleRender::VKShader::VKShader(const std::shared_ptr<VKContext>* context, std:
     pipelineInfo.subpass = 0;
     pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-    vkr = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_GraphicsPipeline);
+    //without a render pass the pipeline is compiled against the attachment formats
+    VkPipelineRenderingCreateInfo renderingInfo = (*m_Context)->GetPipelineRenderingInfo();
+    if ((*m_Context)->IsDynamicRenderingEnabled())
+        pipelineInfo.pNext = &renderingInfo;
+
+    VkPipelineCreationFeedbackEXT pipelineFeedback{};
+    std::vector<VkPipelineCreationFeedbackEXT> stageFeedbacks(shaderStages.size());
+    VkPipelineCreationFeedbackCreateInfoEXT feedbackInfo{};
+    feedbackInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT;
+    feedbackInfo.pPipelineCreationFeedback = &pipelineFeedback;
+    feedbackInfo.pipelineStageCreationFeedbackCount = (uint32_t)stageFeedbacks.size();
+    feedbackInfo.pPipelineStageCreationFeedbacks = stageFeedbacks.data();
+    if ((*m_Context)->IsCreationFeedbackEnabled())
+    {
+        feedbackInfo.pNext = pipelineInfo.pNext;
+        pipelineInfo.pNext = &feedbackInfo;
+    }
+
+    vkr = vkCreateGraphicsPipelines(device, (*m_Context)->GetPipelineCache(), 1, &pipelineInfo, nullptr, &m_GraphicsPipeline);
     assert(vkr == VK_SUCCESS);
 
+    if ((*m_Context)->IsCreationFeedbackEnabled())
+        (*m_Context)->ReportPipelineCreation(json_controller_path, pipelineFeedback);
+
     for (auto it = m_Modules.begin(); it != m_Modules.end(); it++)
     {
         vkDestroyShaderModule(device, it->second, nullptr);
         it->second = nullptr;
     }
 
-    delete[] ied;
-}
-
-SampleRender::VKShader::~VKShader()
-{
-    auto device = (*m_Context)->GetDevice();
-    vkDeviceWaitIdle(device);
-
-    vkFreeCommandBuffers(device, m_CopyCommandPool, 1, &m_CopyCommandBuffer);
-    vkDestroyCommandPool(device, m_CopyCommandPool, nullptr);
-    
-    for (auto& i : m_Textures)
+    //everything WarmUpPipeline needs to rebuild an identical pipeline
+    Json::Value manifestEntry;
+    manifestEntry["Controller"] = json_controller_path;
+    manifestEntry["VertexBindings"] = Json::Value(Json::arrayValue);
+    for (auto& bindingDescription : bindingDescriptions)
     {
-        vkDestroyImageView(device, i.second.View, nullptr);
-        vkFreeMemory(device, i.second.Memory, nullptr);
-        vkDestroyImage(device, i.second.Resource, nullptr);
+        Json::Value vertexBinding;
+        vertexBinding["Binding"] = bindingDescription.binding;
+        vertexBinding["Stride"] = bindingDescription.stride;
+        vertexBinding["Rate"] = (uint32_t)bindingDescription.inputRate;
+        manifestEntry["VertexBindings"].append(vertexBinding);
     }
-
-    for (auto& i : m_Samplers)
+    manifestEntry["Attributes"] = Json::Value(Json::arrayValue);
+    for (size_t i = 0; i < nativeElements.size(); i++)
     {
-        vkDestroySampler(device, i.second, nullptr);
+        Json::Value attribute;
+        attribute["Binding"] = ied[i].binding;
+        attribute["Format"] = (uint32_t)ied[i].format;
+        attribute["Offset"] = ied[i].offset;
+        manifestEntry["Attributes"].append(attribute);
     }
-    for (auto& i : m_Uniforms)
+    manifestEntry["PushConstantStages"] = (uint32_t)pushConstantRange.stageFlags;
+    manifestEntry["PushConstantSize"] = pushConstantRange.size;
+    manifestEntry["Bindless"] = (*m_Context)->GetBindlessHeap() != nullptr;
+    manifestEntry["Bindings"] = Json::Value(Json::arrayValue);
+    for (auto& setBinding : setBindings)
     {
-        vkDestroyBuffer(device, i.second.Resource, nullptr);
-        vkFreeMemory(device, i.second.Memory, nullptr);
+        Json::Value binding;
+        binding["Binding"] = setBinding.binding;
+        binding["Type"] = (uint32_t)setBinding.descriptorType;
+        binding["Stages"] = (uint32_t)setBinding.stageFlags;
+        binding["Count"] = setBinding.descriptorCount;
+        manifestEntry["Bindings"].append(binding);
     }
-    vkDestroyDescriptorPool(device, m_DescriptorPool, nullptr);
-    vkDestroyDescriptorSetLayout(device, m_RootSignature, nullptr);
-    vkDestroyPipeline(device, m_GraphicsPipeline, nullptr);
-    vkDestroyPipelineLayout(device, m_PipelineLayout, nullptr);
+    (*m_Context)->GetPipelineManifest()->Record(manifestEntry);
+
+    delete[] ied;
+    m_Built = true;
 }
 
 void SampleRender::VKShader::Stage()
 {
+    //nothing to bind while the pipeline is still compiling
+    if (!m_Built)
+        return;
     auto commandBuffer = (*m_Context)->GetCurrentCommandBuffer();
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicsPipeline);
+    if (!m_ShaderObjects.empty())
+        StageShaderObjects(commandBuffer);
+    else
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicsPipeline);
+
+    //every texture stays reachable by index, materials switch through push constants only
+    if ((*m_Context)->GetBindlessHeap() != nullptr)
+        (*m_Context)->GetBindlessHeap()->Bind(commandBuffer, m_PipelineLayout);
 }
 
 uint32_t SampleRender::VKShader::GetStride() const
@@ -223,8 +383,15 @@ uint32_t SampleRender::VKShader::GetOffset() const
     return 0;
 }
 
+bool SampleRender::VKShader::IsReady() const
+{
+    return m_Built && (*m_Context)->GetUploadManager()->IsUploadComplete(m_UploadTicket);
+}
+
 void SampleRender::VKShader::BindSmallBuffer(const void* data, size_t size, uint32_t bindingSlot)
 {
+    if (!m_Built)
+        return;
     if (size != m_SmallBufferLayout.GetElement(bindingSlot).GetSize())
         throw SizeMismatchException(size, m_SmallBufferLayout.GetElement(bindingSlot).GetSize());
     VkShaderStageFlags bindingFlag = 0;
@@ -246,6 +413,8 @@ void SampleRender::VKShader::BindSmallBuffer(const void* data, size_t size, uint
 
 void SampleRender::VKShader::BindUniforms(const void* data, size_t size, uint32_t shaderRegister)
 {
+    if (!m_Built)
+        return;
     if (m_Uniforms.find(shaderRegister) == m_Uniforms.end())
         return;
     MapUniform(data, size, shaderRegister);
@@ -254,101 +423,236 @@ void SampleRender::VKShader::BindUniforms(const void* data, size_t size, uint32_
 
 void SampleRender::VKShader::BindTexture(uint32_t bindingSlot)
 {
-    auto commandBuffer = (*m_Context)->GetCurrentCommandBuffer();
+    if (!m_Built)
+        return;
     auto textureElement = m_TextureLayout.GetElement(bindingSlot);
-    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineLayout, 0, 1, &m_DescriptorSets[textureElement.GetSpaceSet()], 0, nullptr);
+    BindDescriptorSet(textureElement.GetSpaceSet());
 }
 
-void SampleRender::VKShader::PreallocatesDescSets()
+uint32_t SampleRender::VKShader::GetTextureIndex(uint32_t shaderRegister) const
 {
-    auto device = (*m_Context)->GetDevice();
+    //the slots are filled by the build, which may still be running on a worker
+    if (!m_Built)
+        return UINT32_MAX;
+    if ((*m_Context)->GetBindlessHeap() == nullptr)
+        return shaderRegister;
+    return m_Textures.at(shaderRegister).BindlessIndex;
+}
 
+uint32_t SampleRender::VKShader::GetSamplerIndex(uint32_t shaderRegister) const
+{
+    //the slots are filled by the build, which may still be running on a worker
+    if (!m_Built)
+        return UINT32_MAX;
+    if ((*m_Context)->GetBindlessHeap() == nullptr)
+        return shaderRegister;
+    return m_SamplerIndices.at(shaderRegister);
+}
+
+void SampleRender::VKShader::WarmUpPipeline(VKContext* context, const Json::Value& entry)
+{
     VkResult vkr;
-    auto textures = m_TextureLayout.GetElements();
-    auto uniforms = m_UniformLayout.GetElements();
+    auto device = context->GetDevice();
+    std::string controllerPath = entry["Controller"].asString();
+    //entries recorded before vertex streams were described per binding
+    if (!entry.isMember("VertexBindings"))
+        return;
 
-    VkDescriptorSetAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    allocInfo.descriptorPool = m_DescriptorPool;
-    allocInfo.descriptorSetCount = 1;
-    allocInfo.pSetLayouts = &m_RootSignature;
+    Json::Reader reader;
+    std::string jsonResult;
+    Json::Value pipelineInfo;
+    if (!FileHandler::ReadTextFile(controllerPath, &jsonResult) || !reader.parse(jsonResult, pipelineInfo))
+        return;
+    std::string shaderDir = fs::path(controllerPath).parent_path().string();
 
-    for (auto& uniformElement : uniforms)
+    std::vector<VkShaderModule> modules;
+    std::vector<std::string> entrypoints;
+    std::vector<VkPipelineShaderStageCreateInfo> shaderStages;
+    entrypoints.reserve(s_GraphicsPipelineStages.size());
+    for (auto& stage : s_GraphicsPipelineStages)
     {
-        if (m_DescriptorSets.find(uniformElement.second.GetSpaceSet()) == m_DescriptorSets.end())
-        {
-            vkr = vkAllocateDescriptorSets(device, &allocInfo, &m_DescriptorSets[uniformElement.second.GetSpaceSet()]);
-            assert(vkr == VK_SUCCESS);
-        }
+        std::stringstream shaderFullPath;
+        shaderFullPath << shaderDir << "/" << pipelineInfo["BinShaders"][stage]["filename"].asString();
+
+        size_t blobSize;
+        std::byte* blobData;
+        if (!FileHandler::FileExists(shaderFullPath.str()) || !FileHandler::ReadBinFile(shaderFullPath.str(), &blobData, &blobSize))
+            continue;
+
+        VkShaderModuleCreateInfo createInfo{};
+        createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        createInfo.codeSize = blobSize;
+        createInfo.pCode = reinterpret_cast<const uint32_t*>(blobData);
+
+        VkShaderModule module;
+        vkr = vkCreateShaderModule(device, &createInfo, nullptr, &module);
+        assert(vkr == VK_SUCCESS);
+        delete[] blobData;
+        modules.push_back(module);
+        entrypoints.push_back(pipelineInfo["BinShaders"][stage]["entrypoint"].asString());
+
+        VkPipelineShaderStageCreateInfo pipelineStage{};
+        pipelineStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipelineStage.stage = s_StageCaster.at(stage);
+        pipelineStage.module = module;
+        pipelineStage.pName = entrypoints.back().c_str();
+        shaderStages.push_back(pipelineStage);
     }
 
-    for (auto& textureElement : textures)
+    std::vector<VkDescriptorSetLayoutBinding> bindings;
+    for (auto& binding : entry["Bindings"])
     {
-        if (m_DescriptorSets.find(textureElement.second.GetSpaceSet()) == m_DescriptorSets.end())
-        {
-            vkr = vkAllocateDescriptorSets(device, &allocInfo, &m_DescriptorSets[textureElement.second.GetSpaceSet()]);
-            assert(vkr == VK_SUCCESS);
-        }
+        VkDescriptorSetLayoutBinding layoutBinding{};
+        layoutBinding.binding = binding["Binding"].asUInt();
+        layoutBinding.descriptorType = (VkDescriptorType)binding["Type"].asUInt();
+        layoutBinding.stageFlags = binding["Stages"].asUInt();
+        layoutBinding.descriptorCount = binding["Count"].asUInt();
+        bindings.push_back(layoutBinding);
     }
 
-    
-}
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
 
-void SampleRender::VKShader::CreateCopyPipeline()
-{
-    auto device = (*m_Context)->GetDevice();
-    auto adapter = (*m_Context)->GetAdapter();
-    VkResult vkr;
+    VkDescriptorSetLayout setLayout;
+    vkr = vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &setLayout);
+    assert(vkr == VK_SUCCESS);
 
-    QueueFamilyIndices queueFamilyIndices = FindQueueFamilies(adapter);
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = entry["PushConstantStages"].asUInt();
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = entry["PushConstantSize"].asUInt();
 
-    VkCommandPoolCreateInfo poolInfo{};
-    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-    poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    //the layout has to match the one the shader will be built with, or the warmed pipeline is not reused
+    std::vector<VkDescriptorSetLayout> setLayouts = { setLayout };
+    if (entry["Bindless"].asBool() && (context->GetBindlessHeap() != nullptr))
+        setLayouts.push_back(context->GetBindlessHeap()->GetLayout());
+    pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+    pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
-    vkr = vkCreateCommandPool(device, &poolInfo, nullptr, &m_CopyCommandPool);
+    VkPipelineLayout pipelineLayout;
+    vkr = vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout);
     assert(vkr == VK_SUCCESS);
 
-    VkCommandBufferAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.commandPool = m_CopyCommandPool;
-    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandBufferCount = 1;
+    std::vector<VkVertexInputBindingDescription> bindingDescriptions;
+    for (auto& vertexBinding : entry["VertexBindings"])
+    {
+        VkVertexInputBindingDescription bindingDescription{};
+        bindingDescription.binding = vertexBinding["Binding"].asUInt();
+        bindingDescription.stride = vertexBinding["Stride"].asUInt();
+        bindingDescription.inputRate = (VkVertexInputRate)vertexBinding["Rate"].asUInt();
+        bindingDescriptions.push_back(bindingDescription);
+    }
 
-    vkr = vkAllocateCommandBuffers(device, &allocInfo, &m_CopyCommandBuffer);
-    assert(vkr == VK_SUCCESS);
+    std::vector<VkVertexInputAttributeDescription> attributes;
+    for (auto& attribute : entry["Attributes"])
+    {
+        VkVertexInputAttributeDescription attributeDescription{};
+        attributeDescription.binding = attribute["Binding"].asUInt();
+        attributeDescription.location = (uint32_t)attributes.size();
+        attributeDescription.format = (VkFormat)attribute["Format"].asUInt();
+        attributeDescription.offset = attribute["Offset"].asUInt();
+        attributes.push_back(attributeDescription);
+    }
 
-    vkGetDeviceQueue(device, 0, 0, &m_CopyQueue);
-}
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputInfo.vertexBindingDescriptionCount = (uint32_t)bindingDescriptions.size();
+    vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
+    vertexInputInfo.vertexAttributeDescriptionCount = (uint32_t)attributes.size();
+    vertexInputInfo.pVertexAttributeDescriptions = attributes.data();
 
-SampleRender::QueueFamilyIndices SampleRender::VKShader::FindQueueFamilies(VkPhysicalDevice adapter)
-{
-    auto surface = (*m_Context)->GetSurface();
-    QueueFamilyIndices indices;
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+    VkPipelineViewportStateCreateInfo viewportState{};
+    VkPipelineMultisampleStateCreateInfo multisampling{};
+    VkPipelineRasterizationStateCreateInfo rasterizer{};
+    VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+    VkPipelineColorBlendStateCreateInfo colorBlending{};
+    VkPipelineDepthStencilStateCreateInfo depthStencil{};
 
-    uint32_t queueFamilyCount = 0;
-    vkGetPhysicalDeviceQueueFamilyProperties(adapter, &queueFamilyCount, nullptr);
+    SetInputAssemblyViewportAndMultisampling(&inputAssembly, &viewportState, &multisampling);
+    SetRasterizer(&rasterizer);
+    SetBlend(&colorBlendAttachment, &colorBlending);
+    SetDepthStencil(&depthStencil);
 
-    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
-    vkGetPhysicalDeviceQueueFamilyProperties(adapter, &queueFamilyCount, queueFamilies.data());
+    VkPipelineDynamicStateCreateInfo dynamicState{};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = static_cast<uint32_t>(s_DynamicStates.size());
+    dynamicState.pDynamicStates = s_DynamicStates.data();
+
+    VkGraphicsPipelineCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    createInfo.stageCount = (uint32_t)shaderStages.size();
+    createInfo.pStages = shaderStages.data();
+    createInfo.pVertexInputState = &vertexInputInfo;
+    createInfo.pInputAssemblyState = &inputAssembly;
+    createInfo.pViewportState = &viewportState;
+    createInfo.pRasterizationState = &rasterizer;
+    createInfo.pMultisampleState = &multisampling;
+    createInfo.pColorBlendState = &colorBlending;
+    createInfo.pDynamicState = &dynamicState;
+    createInfo.pDepthStencilState = &depthStencil;
+    createInfo.layout = pipelineLayout;
+    createInfo.renderPass = context->GetRenderPass();
+    createInfo.subpass = 0;
+    createInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+    VkPipelineRenderingCreateInfo renderingInfo = context->GetPipelineRenderingInfo();
+    if (context->IsDynamicRenderingEnabled())
+        createInfo.pNext = &renderingInfo;
+
+    VkPipelineCreationFeedbackEXT pipelineFeedback{};
+    VkPipelineCreationFeedbackCreateInfoEXT feedbackInfo{};
+    feedbackInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT;
+    feedbackInfo.pPipelineCreationFeedback = &pipelineFeedback;
+    if (context->IsCreationFeedbackEnabled())
+    {
+        feedbackInfo.pNext = createInfo.pNext;
+        createInfo.pNext = &feedbackInfo;
+    }
 
-    int i = 0;
-    for (const auto& queueFamily : queueFamilies)
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    if (shaderStages.size() == s_GraphicsPipelineStages.size())
     {
-        if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
-            indices.graphicsFamily = i;
-        VkBool32 presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(adapter, i, surface, &presentSupport);
-        if (presentSupport)
-            indices.presentFamily = i;
-
-        if (indices.isComplete())
-            break;
-        i++;
+        vkr = vkCreateGraphicsPipelines(device, context->GetPipelineCache(), 1, &createInfo, nullptr, &pipeline);
+        if ((vkr == VK_SUCCESS) && context->IsCreationFeedbackEnabled())
+            context->ReportPipelineCreation(controllerPath + " (warm-up)", pipelineFeedback);
     }
 
-    return indices;
+    //the cache keeps the compiled result, the objects themselves are not needed
+    if (pipeline != VK_NULL_HANDLE)
+        vkDestroyPipeline(device, pipeline, nullptr);
+    vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+    for (auto module : modules)
+        vkDestroyShaderModule(device, module, nullptr);
+}
+
+void SampleRender::VKShader::PreallocatesDescSets()
+{
+    auto descriptorAllocator = (*m_Context)->GetDescriptorAllocator();
+    auto uniforms = m_UniformLayout.GetElements();
+
+    //spaces with textures are written per frame through the descriptor cache
+    for (auto& uniformElement : uniforms)
+    {
+        uint32_t spaceSet = uniformElement.second.GetSpaceSet();
+        if (!HasTextures(spaceSet) && (m_DescriptorSets.find(spaceSet) == m_DescriptorSets.end()))
+            m_DescriptorSets[spaceSet] = descriptorAllocator->Allocate(m_RootSignature);
+    }
+}
+
+bool SampleRender::VKShader::HasTextures(uint32_t spaceSet)
+{
+    for (auto& textureElement : m_TextureLayout.GetElements())
+        if (textureElement.second.GetSpaceSet() == spaceSet)
+            return true;
+    return false;
 }
 
 bool SampleRender::VKShader::IsUniformValid(size_t size)
@@ -361,118 +665,122 @@ void SampleRender::VKShader::PreallocateUniform(const void* data, UniformElement
     if (!IsUniformValid(uniformElement.GetSize()))
         throw AttachmentMismatchException(uniformElement.GetSize(), (*m_Context)->GetUniformAttachment());
 
-    VkResult vkr;
-    auto device = (*m_Context)->GetDevice();
-    VkDeviceSize bufferSize = uniformElement.GetSize();
-    m_Uniforms[uniformElement.GetBindingSlot()] = {};
-
-    VkBufferCreateInfo bufferInfo{};
-    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    bufferInfo.size = uniformElement.GetSize();
-    bufferInfo.usage = GetNativeBufferUsage(uniformElement.GetBufferType());
-    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-    vkr = vkCreateBuffer(device, &bufferInfo, nullptr, &m_Uniforms[uniformElement.GetBindingSlot()].Resource);
-    assert(vkr == VK_SUCCESS);
-
-    VkMemoryRequirements memRequirements;
-    vkGetBufferMemoryRequirements(device, m_Uniforms[uniformElement.GetBindingSlot()].Resource, &memRequirements);
-
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-    vkr = vkAllocateMemory(device, &allocInfo, nullptr, &m_Uniforms[uniformElement.GetBindingSlot()].Memory);
-    assert(vkr == VK_SUCCESS);
-
-    vkBindBufferMemory(device, m_Uniforms[uniformElement.GetBindingSlot()].Resource, m_Uniforms[uniformElement.GetBindingSlot()].Memory, 0);
+    DynamicUniform& uniform = m_Uniforms[uniformElement.GetShaderRegister()];
+    uniform.Data.assign((const uint8_t*)data, (const uint8_t*)data + uniformElement.GetSize());
+    uniform.Offset = 0;
+    //never pushed, the first bind writes it into the frame allocator
+    uniform.Epoch = 0;
+}
 
-    MapUniform(data, uniformElement.GetSize(), uniformElement.GetBindingSlot());
+void SampleRender::VKShader::MapUniform(const void* data, size_t size, uint32_t shaderRegister)
+{
+    DynamicUniform& uniform = m_Uniforms[shaderRegister];
+    memcpy(uniform.Data.data(), data, std::min(size, uniform.Data.size()));
+    PushUniform(shaderRegister);
 }
 
-void SampleRender::VKShader::MapUniform(const void* data, size_t size, uint32_t bindingSlot)
+void SampleRender::VKShader::PushUniform(uint32_t shaderRegister)
 {
-    VkResult vkr;
-    void* gpuData;
-    auto device = (*m_Context)->GetDevice();
-    vkr = vkMapMemory(device, m_Uniforms[bindingSlot].Memory, 0, size, 0, &gpuData);
-    assert(vkr == VK_SUCCESS);
-    memcpy(gpuData, data, size);
-    vkUnmapMemory(device, m_Uniforms[bindingSlot].Memory);
+    auto frameAllocator = (*m_Context)->GetFrameAllocator();
+    DynamicUniform& uniform = m_Uniforms[shaderRegister];
+    VkDeviceSize offset;
+    memcpy(frameAllocator->Allocate(uniform.Data.size(), offset), uniform.Data.data(), uniform.Data.size());
+    uniform.Offset = (uint32_t)offset;
+    uniform.Epoch = frameAllocator->GetEpoch();
 }
 
-void SampleRender::VKShader::BindUniform(uint32_t bindingSlot)
+void SampleRender::VKShader::BindUniform(uint32_t shaderRegister)
 {
-    auto commandBuffer = (*m_Context)->GetCurrentCommandBuffer();
-    auto uniformElement = m_UniformLayout.GetElement(bindingSlot);
-    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineLayout, 0, 1, &m_DescriptorSets[uniformElement.GetSpaceSet()], 0, nullptr);
+    auto uniformElement = m_UniformLayout.GetElement(shaderRegister);
+    BindDescriptorSet(uniformElement.GetSpaceSet());
 }
 
-uint32_t SampleRender::VKShader::FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
+void SampleRender::VKShader::BindDescriptorSet(uint32_t spaceSet)
 {
-    auto adapter = (*m_Context)->GetAdapter();
-    VkPhysicalDeviceMemoryProperties memProperties;
-    vkGetPhysicalDeviceMemoryProperties(adapter, &memProperties);
+    auto commandBuffer = (*m_Context)->GetCurrentCommandBuffer();
+    uint64_t epoch = (*m_Context)->GetFrameAllocator()->GetEpoch();
 
-    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-        if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-            return i;
-        }
+    //set 0 declares the uniforms of every space as dynamic, each one takes an offset, in binding order
+    std::vector<uint32_t> shaderRegisters;
+    for (auto& uniformElement : m_UniformLayout.GetElements())
+        shaderRegisters.push_back(uniformElement.second.GetShaderRegister());
+    std::sort(shaderRegisters.begin(), shaderRegisters.end());
+
+    std::vector<uint32_t> dynamicOffsets;
+    for (auto shaderRegister : shaderRegisters)
+    {
+        if (m_Uniforms[shaderRegister].Epoch != epoch)
+            PushUniform(shaderRegister);
+        dynamicOffsets.push_back(m_Uniforms[shaderRegister].Offset);
     }
+    VkDescriptorSet set = HasTextures(spaceSet) ? GetCachedTextureSet(spaceSet) : m_DescriptorSets[spaceSet];
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineLayout, 0, 1, &set, (uint32_t)dynamicOffsets.size(), dynamicOffsets.data());
+}
 
-    return 0xffffffff;
+VkDescriptorSet SampleRender::VKShader::GetCachedTextureSet(uint32_t spaceSet)
+{
+    //every dynamic binding of the layout is written, BindDescriptorSet offsets all of them
+    std::vector<VKDescriptorBinding> bindings;
+    for (auto& uniformElement : m_UniformLayout.GetElements())
+    {
+        VKDescriptorBinding binding;
+        binding.Binding = uniformElement.second.GetShaderRegister();
+        binding.Type = GetNativeDescriptorType(uniformElement.second.GetBufferType());
+        binding.Buffer.buffer = (*m_Context)->GetFrameAllocator()->GetBuffer();
+        binding.Buffer.offset = 0;
+        binding.Buffer.range = uniformElement.second.GetSize();
+        bindings.push_back(binding);
+    }
+    for (auto& textureElement : m_TextureLayout.GetElements())
+    {
+        if (textureElement.second.GetSpaceSet() != spaceSet)
+            continue;
+        VKDescriptorBinding binding;
+        binding.Binding = textureElement.second.GetShaderRegister();
+        binding.Type = GetNativeDescriptorType(BufferType::TEXTURE_BUFFER);
+        binding.Image.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        binding.Image.imageView = m_Textures[textureElement.second.GetShaderRegister()].View;
+        binding.Image.sampler = m_Samplers[textureElement.second.GetSamplerRegister()];
+        bindings.push_back(binding);
+    }
+    //the same views give back the same set until the frame slot is reset
+    return (*m_Context)->GetDescriptorAllocator()->GetCachedSet(m_RootSignature, bindings);
 }
 
 void SampleRender::VKShader::CreateTexture(TextureElement textureElement)
 {
     AllocateTexture(textureElement);
     CopyTextureBuffer(textureElement);
+    if ((*m_Context)->GetBindlessHeap() != nullptr)
+        m_Textures[textureElement.GetShaderRegister()].BindlessIndex = (*m_Context)->GetBindlessHeap()->RegisterTexture(m_Textures[textureElement.GetShaderRegister()].View);
 }
 
 void SampleRender::VKShader::AllocateTexture(TextureElement textureElement)
 {
     VkResult vkr;
     auto device = (*m_Context)->GetDevice();
-    VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-
-    VkImageCreateInfo imageInfo{};
-    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-    imageInfo.imageType = GetNativeTensor(textureElement.GetTensor());
-    //params
-    imageInfo.extent.width = textureElement.GetWidth();
-    imageInfo.extent.height = textureElement.GetHeight();
-    imageInfo.extent.depth = textureElement.GetDepth();
-    imageInfo.mipLevels = textureElement.GetMipsLevel();
+    bool hostTransfer = UsesHostImageCopy();
+    VkMemoryPropertyFlags properties = hostTransfer ? (*m_Context)->GetMemoryAllocator()->GetDeviceLocalProperties() : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
 
-    imageInfo.arrayLayers = 1;
-    imageInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
-    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VkImageCreateInfo imageInfo = GetTextureImageInfo(textureElement, hostTransfer);
 
     vkr = vkCreateImage(device, &imageInfo, nullptr, &m_Textures[textureElement.GetShaderRegister()].Resource);
     assert(vkr == VK_SUCCESS);
 
-    VkMemoryRequirements memRequirements;
-    vkGetImageMemoryRequirements(device, m_Textures[textureElement.GetShaderRegister()].Resource, &memRequirements);
-
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, properties);
-
-    vkr = vkAllocateMemory(device, &allocInfo, nullptr, &m_Textures[textureElement.GetShaderRegister()].Memory);
-    assert(vkr == VK_SUCCESS);
+    m_Textures[textureElement.GetShaderRegister()].Memory = (*m_Context)->GetMemoryAllocator()->AllocateImage(m_Textures[textureElement.GetShaderRegister()].Resource, properties);
+    (*m_Context)->GetMemoryAllocator()->SetRelocatable(m_Textures[textureElement.GetShaderRegister()].Memory, this);
+    m_Textures[textureElement.GetShaderRegister()].View = CreateTextureView(m_Textures[textureElement.GetShaderRegister()].Resource);
+}
 
-    vkr = vkBindImageMemory(device, m_Textures[textureElement.GetShaderRegister()].Resource, m_Textures[textureElement.GetShaderRegister()].Memory, 0);
-    assert(vkr == VK_SUCCESS);
+VkImageView SampleRender::VKShader::CreateTextureView(VkImage image)
+{
+    VkResult vkr;
+    auto device = (*m_Context)->GetDevice();
+    VkImageView view;
 
     VkImageViewCreateInfo viewInfo{};
     viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-    viewInfo.image = m_Textures[textureElement.GetShaderRegister()].Resource;
+    viewInfo.image = image;
     viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
     viewInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
     viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -481,137 +789,166 @@ void SampleRender::VKShader::AllocateTexture(TextureElement textureElement)
     viewInfo.subresourceRange.baseArrayLayer = 0;
     viewInfo.subresourceRange.layerCount = 1;
 
-    vkr = vkCreateImageView(device, &viewInfo, nullptr, &m_Textures[textureElement.GetShaderRegister()].View);
+    vkr = vkCreateImageView(device, &viewInfo, nullptr, &view);
     assert(vkr == VK_SUCCESS);
-
+    return view;
 }
 
-void SampleRender::VKShader::CopyTextureBuffer(TextureElement textureElement)
+VkImageCreateInfo SampleRender::VKShader::GetTextureImageInfo(TextureElement textureElement, bool hostTransfer)
 {
-    VkResult vkr;
-    auto device = (*m_Context)->GetDevice();
-    VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    size_t imageSize = (textureElement.GetWidth() * textureElement.GetHeight() * textureElement.GetDepth() * textureElement.GetChannels());
-
-    VkBufferCreateInfo bufferInfo{};
-    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    bufferInfo.size = imageSize;
-    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = GetNativeTensor(textureElement.GetTensor());
+    //params
+    imageInfo.extent.width = textureElement.GetWidth();
+    imageInfo.extent.height = textureElement.GetHeight();
+    imageInfo.extent.depth = textureElement.GetDepth();
+    imageInfo.mipLevels = textureElement.GetMipsLevel();
 
-    vkr = vkCreateBuffer(device, &bufferInfo, nullptr, &stagingBuffer);
-    assert(vkr == VK_SUCCESS);
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    //transfer source lets defragmentation copy the texture into a new range
+    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    if (hostTransfer)
+        imageInfo.usage |= VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    return imageInfo;
+}
 
-    VkMemoryRequirements memRequirements;
-    vkGetBufferMemoryRequirements(device, stagingBuffer, &memRequirements);
+bool SampleRender::VKShader::CanRelocate(bool gpuIdle, uint64_t completedUpload) const
+{
+    return gpuIdle && m_Built && (m_UploadTicket <= completedUpload);
+}
 
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, properties);
+void SampleRender::VKShader::Relocate(VkCommandBuffer commandBuffer, const VKAllocation& oldMemory, const VKAllocation& newMemory)
+{
+    VkResult vkr;
+    auto device = (*m_Context)->GetDevice();
 
-    vkr = vkAllocateMemory(device, &allocInfo, nullptr, &stagingBufferMemory);
+    auto it = std::find_if(m_Textures.begin(), m_Textures.end(), [&oldMemory](const std::pair<const uint32_t, IMGB>& texture)
+    {
+        return (texture.second.Memory.Memory == oldMemory.Memory) && (texture.second.Memory.Offset == oldMemory.Offset);
+    });
+    assert(it != m_Textures.end());
+    TextureElement textureElement = m_TextureLayout.GetElement(it->first);
+
+    //same usage as the original, so the image fits the memory type of the pool it moves within
+    VkImageCreateInfo imageInfo = GetTextureImageInfo(textureElement, UsesHostImageCopy());
+    IMGB texture;
+    vkr = vkCreateImage(device, &imageInfo, nullptr, &texture.Resource);
     assert(vkr == VK_SUCCESS);
-
-    vkBindBufferMemory(device, stagingBuffer, stagingBufferMemory, 0);
-
-    void* GPUData = nullptr;
-    vkr = vkMapMemory(device, stagingBufferMemory, 0, imageSize, 0, &GPUData);
+    vkr = vkBindImageMemory(device, texture.Resource, newMemory.Memory, newMemory.Offset);
     assert(vkr == VK_SUCCESS);
-    memcpy(GPUData, textureElement.GetTextureBuffer(), imageSize);
-    vkUnmapMemory(device, stagingBufferMemory);
-
-    VkCommandBufferBeginInfo beginInfo{};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-    vkBeginCommandBuffer(m_CopyCommandBuffer, &beginInfo);
-
-    VkImageMemoryBarrier barrier{};
-    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.image = m_Textures[textureElement.GetShaderRegister()].Resource;
-    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    barrier.subresourceRange.baseMipLevel = 0;
-    barrier.subresourceRange.levelCount = 1;
-    barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount = 1;
-    barrier.srcAccessMask = 0;
-    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-    VkPipelineStageFlags sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-    VkPipelineStageFlags destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-
-    vkCmdPipelineBarrier(
-        m_CopyCommandBuffer,
-        sourceStage, destinationStage,
-        0,
-        0, nullptr,
-        0, nullptr,
-        1, &barrier
-    );
+    texture.Memory = newMemory;
+    texture.View = CreateTextureView(texture.Resource);
 
-    VkBufferImageCopy region{};
-    region.bufferOffset = 0;
-    region.bufferRowLength = 0;
-    region.bufferImageHeight = 0;
-    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    region.imageSubresource.mipLevel = 0;
-    region.imageSubresource.baseArrayLayer = 0;
-    region.imageSubresource.layerCount = 1;
-    region.imageOffset = { 0, 0, 0 };
-    region.imageExtent = {
-        textureElement.GetWidth(),
-        textureElement.GetHeight(),
-        textureElement.GetDepth()
-    };
-
-    vkCmdCopyBufferToImage(m_CopyCommandBuffer, stagingBuffer, m_Textures[textureElement.GetShaderRegister()].Resource, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-
-    barrier = {};
-    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.image = m_Textures[textureElement.GetShaderRegister()].Resource;
-    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    barrier.subresourceRange.baseMipLevel = 0;
-    barrier.subresourceRange.levelCount = 1;
-    barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount = 1;
-    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-    sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-    destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-
-    vkCmdPipelineBarrier(
-        m_CopyCommandBuffer,
-        sourceStage, destinationStage,
-        0,
-        0, nullptr,
-        0, nullptr,
-        1, &barrier
-    );
+    //only the first level is uploaded and viewed, the others were never written
+    std::array<VkImageMemoryBarrier, 2> barriers{};
+    for (auto& barrier : barriers)
+    {
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+    }
+    barriers[0].image = it->second.Resource;
+    barriers[0].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    //the upload copy wrote the source, the frames sampled it
+    barriers[0].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT;
+    barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    barriers[1].image = texture.Resource;
+    barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barriers[1].srcAccessMask = 0;
+    barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, (uint32_t)barriers.size(), barriers.data());
+
+    VkImageCopy region{};
+    region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.srcSubresource.mipLevel = 0;
+    region.srcSubresource.baseArrayLayer = 0;
+    region.srcSubresource.layerCount = 1;
+    region.dstSubresource = region.srcSubresource;
+    region.extent = imageInfo.extent;
+    vkCmdCopyImage(commandBuffer, it->second.Resource, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, texture.Resource, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+    barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    //bindless textures can be sampled from the vertex stage too
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barriers[1]);
+
+    IMGB oldTexture = it->second;
+    VKMemoryAllocator* allocator = (*m_Context)->GetMemoryAllocator();
+    (*m_Context)->EnqueueDestruction([device, oldTexture, allocator]()
+    {
+        vkDestroyImageView(device, oldTexture.View, nullptr);
+        vkDestroyImage(device, oldTexture.Resource, nullptr);
+        allocator->Free(oldTexture.Memory);
+    });
+
+    texture.BindlessIndex = oldTexture.BindlessIndex;
+    //the frame sets pick the new view up on their next bind
+    it->second = texture;
+    if ((*m_Context)->GetBindlessHeap() != nullptr)
+        (*m_Context)->GetBindlessHeap()->UpdateTexture(texture.BindlessIndex, texture.View);
+}
 
-    vkEndCommandBuffer(m_CopyCommandBuffer);
+void SampleRender::VKShader::CopyTextureBuffer(TextureElement textureElement)
+{
+    size_t imageSize = (textureElement.GetWidth() * textureElement.GetHeight() * textureElement.GetDepth() * textureElement.GetChannels());
+    VkExtent3D extent = { textureElement.GetWidth(), textureElement.GetHeight(), textureElement.GetDepth() };
+    VkImage image = m_Textures[textureElement.GetShaderRegister()].Resource;
 
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &m_CopyCommandBuffer;
+    if (UsesHostImageCopy())
+    {
+        VkResult vkr;
+        auto device = (*m_Context)->GetDevice();
+        const HostImageCopyDispatch& dispatch = (*m_Context)->GetHostImageCopyDispatch();
+
+        //the image is new, no queue can be using it while the host writes
+        VkHostImageLayoutTransitionInfoEXT transition{};
+        transition.sType = VK_STRUCTURE_TYPE_HOST_IMAGE_LAYOUT_TRANSITION_INFO_EXT;
+        transition.image = image;
+        transition.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        transition.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        transition.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+        vkr = dispatch.TransitionImageLayout(device, 1, &transition);
+        assert(vkr == VK_SUCCESS);
+
+        VkMemoryToImageCopyEXT region{};
+        region.sType = VK_STRUCTURE_TYPE_MEMORY_TO_IMAGE_COPY_EXT;
+        region.pHostPointer = textureElement.GetTextureBuffer();
+        region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+        region.imageExtent = extent;
+
+        VkCopyMemoryToImageInfoEXT copyInfo{};
+        copyInfo.sType = VK_STRUCTURE_TYPE_COPY_MEMORY_TO_IMAGE_INFO_EXT;
+        copyInfo.dstImage = image;
+        copyInfo.dstImageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        copyInfo.regionCount = 1;
+        copyInfo.pRegions = &region;
+        vkr = dispatch.CopyMemoryToImage(device, &copyInfo);
+        assert(vkr == VK_SUCCESS);
+        return;
+    }
 
-    vkQueueSubmit(m_CopyQueue, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(m_CopyQueue);
+    uint64_t ticket = (*m_Context)->GetUploadManager()->UploadImage(image, textureElement.GetTextureBuffer(), imageSize, extent);
+    m_UploadTicket = std::max(m_UploadTicket, ticket);
+}
 
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingBufferMemory, nullptr);
+bool SampleRender::VKShader::UsesHostImageCopy() const
+{
+    return (*m_Context)->IsHostImageCopyEnabled() && (*m_Context)->GetMemoryAllocator()->SupportsDirectUploads();
 }
 
 void SampleRender::VKShader::CreateSampler(SamplerElement samplerElement)
@@ -640,15 +977,24 @@ void SampleRender::VKShader::CreateSampler(SamplerElement samplerElement)
 
     vkr = vkCreateSampler(device, &samplerInfo, nullptr, &m_Samplers[samplerElement.GetShaderRegister()]);
     assert(vkr == VK_SUCCESS);
+
+    if ((*m_Context)->GetBindlessHeap() != nullptr)
+        m_SamplerIndices[samplerElement.GetShaderRegister()] = (*m_Context)->GetBindlessHeap()->RegisterSampler(m_Samplers[samplerElement.GetShaderRegister()]);
+}
+
+std::vector<VkDescriptorSetLayout> SampleRender::VKShader::GetSetLayouts() const
+{
+    std::vector<VkDescriptorSetLayout> setLayouts = { m_RootSignature };
+    if ((*m_Context)->GetBindlessHeap() != nullptr)
+        setLayouts.push_back((*m_Context)->GetBindlessHeap()->GetLayout());
+    return setLayouts;
 }
 
-void SampleRender::VKShader::CreateDescriptorSetLayout()
+void SampleRender::VKShader::CreateDescriptorSetLayout(std::vector<VkDescriptorSetLayoutBinding>* bindings)
 {
     VkResult vkr;
     auto device = (*m_Context)->GetDevice();
 
-    std::vector<VkDescriptorSetLayoutBinding> bindings;
-
     auto uniformElements = m_UniformLayout.GetElements();
 
     for (auto& i : uniformElements)
@@ -656,7 +1002,7 @@ void SampleRender::VKShader::CreateDescriptorSetLayout()
         VkDescriptorSetLayoutBinding binding{};
         binding.binding = i.second.GetShaderRegister();
         binding.descriptorCount = 1;
-        binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        binding.descriptorType = GetNativeDescriptorType(i.second.GetBufferType());
         binding.pImmutableSamplers = nullptr;
         VkShaderStageFlags stageFlag = 0x0;
 
@@ -665,7 +1011,7 @@ void SampleRender::VKShader::CreateDescriptorSetLayout()
                 stageFlag |= i.second;
 
         binding.stageFlags = stageFlag;
-        bindings.push_back(binding);
+        bindings->push_back(binding);
     }
 
     auto textureElements = m_TextureLayout.GetElements();
@@ -678,117 +1024,57 @@ void SampleRender::VKShader::CreateDescriptorSetLayout()
         binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
         binding.pImmutableSamplers = nullptr;
         binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-        bindings.push_back(binding);
+        bindings->push_back(binding);
     }
 
     VkDescriptorSetLayoutCreateInfo layoutInfo{};
     layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
-    layoutInfo.pBindings = bindings.data();
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings->size());
+    layoutInfo.pBindings = bindings->data();
 
     vkr = vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &m_RootSignature);
     assert(vkr == VK_SUCCESS);
 }
 
-void SampleRender::VKShader::CreateDescriptorPool()
-{
-    VkResult vkr;
-    auto device = (*m_Context)->GetDevice();
-
-    std::vector<VkDescriptorPoolSize> poolSize;
-    auto uniformElements = m_UniformLayout.GetElements();
-    for (auto& i : uniformElements)
-    {
-        VkDescriptorPoolSize poolSizer;
-        poolSizer.type = GetNativeDescriptorType(i.second.GetBufferType());
-        poolSizer.descriptorCount = 1;
-        poolSize.push_back(poolSizer);
-    }
-    
-    auto textureElements = m_TextureLayout.GetElements();
-    for (auto& i : textureElements)
-    {
-        VkDescriptorPoolSize poolSizer;
-        poolSizer.type = GetNativeDescriptorType(BufferType::TEXTURE_BUFFER);
-        poolSizer.descriptorCount = 1;
-        poolSize.push_back(poolSizer);
-    }
-
-    VkDescriptorPoolCreateInfo poolInfo{};
-    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    poolInfo.poolSizeCount = 1;
-    poolInfo.pPoolSizes = poolSize.data();
-    poolInfo.maxSets = poolSize.size();
-
-    vkr = vkCreateDescriptorPool(device, &poolInfo, nullptr, &m_DescriptorPool);
-    assert(vkr == VK_SUCCESS);
-}
-
 void SampleRender::VKShader::CreateDescriptorSets()
 {
-    VkResult vkr;
     auto device = (*m_Context)->GetDevice();
 
     std::vector<VkWriteDescriptorSet> descriptorWrites;
-    std::vector<VkDescriptorImageInfo> imageInfos;
     std::vector<VkDescriptorBufferInfo> bufferInfos;
-    
-    auto textures = m_TextureLayout.GetElements();
+
     auto uniforms = m_UniformLayout.GetElements();
-    
-    size_t i = 0;
+    //the writes point into it, it must not reallocate
+    bufferInfos.reserve(uniforms.size());
 
+    //m_DescriptorSets only holds the spaces without textures, the others are written in GetCachedTextureSet
     for (auto& uniformElement : uniforms)
     {
         VkDescriptorBufferInfo bufferInfo{};
-        bufferInfo.buffer = m_Uniforms[uniformElement.second.GetShaderRegister()].Resource;
+        bufferInfo.buffer = (*m_Context)->GetFrameAllocator()->GetBuffer();
         bufferInfo.offset = 0;
         bufferInfo.range = uniformElement.second.GetSize();
 
         bufferInfos.push_back(bufferInfo);
 
-        VkWriteDescriptorSet descriptorWrite{};
-        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrite.dstSet = m_DescriptorSets[uniformElement.second.GetSpaceSet()];
-        descriptorWrite.dstBinding = uniformElement.second.GetShaderRegister();
-        descriptorWrite.dstArrayElement = 0;
-        descriptorWrite.descriptorType = GetNativeDescriptorType(uniformElement.second.GetBufferType());
-        descriptorWrite.descriptorCount = 1;
-        descriptorWrite.pBufferInfo = &bufferInfos[i];
-
-        descriptorWrites.push_back(descriptorWrite);
-        i++;
-    }
-    
-    i = 0;
-    for (auto& textureElement : textures)
-    {
-        
-        //assert(vkr == VK_SUCCESS);
-
-        VkDescriptorImageInfo imageInfo{};
-        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        imageInfo.imageView = m_Textures[textureElement.second.GetShaderRegister()].View;
-        imageInfo.sampler = m_Samplers[textureElement.second.GetSamplerRegister()];
-
-        imageInfos.push_back(imageInfo);
-
-        VkWriteDescriptorSet descriptorWrite{};
-        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrite.dstSet = m_DescriptorSets[textureElement.second.GetSpaceSet()];
-        descriptorWrite.dstBinding = textureElement.second.GetShaderRegister();
-        descriptorWrite.dstArrayElement = 0;
-        descriptorWrite.descriptorType = GetNativeDescriptorType(BufferType::TEXTURE_BUFFER);
-        descriptorWrite.descriptorCount = 1;
-        descriptorWrite.pImageInfo = &imageInfos[i];
-
-        descriptorWrites.push_back(descriptorWrite);
-
-        i++;
+        //every set gets every uniform, BindDescriptorSet offsets all the dynamic bindings of the layout
+        for (auto& descriptorSet : m_DescriptorSets)
+        {
+            VkWriteDescriptorSet descriptorWrite{};
+            descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrite.dstSet = descriptorSet.second;
+            descriptorWrite.dstBinding = uniformElement.second.GetShaderRegister();
+            descriptorWrite.dstArrayElement = 0;
+            descriptorWrite.descriptorType = GetNativeDescriptorType(uniformElement.second.GetBufferType());
+            descriptorWrite.descriptorCount = 1;
+            descriptorWrite.pBufferInfo = &bufferInfos.back();
+
+            descriptorWrites.push_back(descriptorWrite);
+        }
     }
 
-    vkUpdateDescriptorSets(device, descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
-    descriptorWrites.clear();
+    if (!descriptorWrites.empty())
+        vkUpdateDescriptorSets(device, (uint32_t)descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
 }
 
 void SampleRender::VKShader::BindSmallBufferIntern(const void* data, size_t size, uint32_t bindingSlot, size_t offset)
@@ -848,6 +1134,110 @@ void SampleRender::VKShader::PushShader(std::string_view stage, VkPipelineShader
     delete[] blobData;
 }
 
+void SampleRender::VKShader::CreateShaderObjects(const VkPushConstantRange& pushConstantRange)
+{
+    VkResult vkr;
+    auto device = (*m_Context)->GetDevice();
+
+    std::vector<VkDescriptorSetLayout> setLayouts = GetSetLayouts();
+    std::vector<std::byte*> blobs;
+    std::vector<VkShaderCreateInfoEXT> createInfos;
+    for (auto& stage : s_GraphicsPipelineStages)
+    {
+        std::stringstream shaderFullPath;
+        shaderFullPath << m_ShaderDir << "/" << m_PipelineInfo["BinShaders"][stage]["filename"].asString();
+        m_ModulesEntrypoint[stage] = m_PipelineInfo["BinShaders"][stage]["entrypoint"].asString();
+
+        size_t blobSize;
+        std::byte* blobData;
+        if (!FileHandler::FileExists(shaderFullPath.str()) || !FileHandler::ReadBinFile(shaderFullPath.str(), &blobData, &blobSize))
+            continue;
+        blobs.push_back(blobData);
+
+        VkShaderCreateInfoEXT createInfo{};
+        createInfo.sType = VK_STRUCTURE_TYPE_SHADER_CREATE_INFO_EXT;
+        createInfo.stage = s_StageCaster.at(stage);
+        createInfo.codeType = VK_SHADER_CODE_TYPE_SPIRV_EXT;
+        createInfo.codeSize = blobSize;
+        createInfo.pCode = blobData;
+        createInfo.pName = m_ModulesEntrypoint[stage].c_str();
+        createInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+        createInfo.pSetLayouts = setLayouts.data();
+        createInfo.pushConstantRangeCount = 1;
+        createInfo.pPushConstantRanges = &pushConstantRange;
+        createInfos.push_back(createInfo);
+        m_ShaderObjectStages.push_back(createInfo.stage);
+    }
+
+    //linking lets the driver optimize across the interface, like a pipeline would
+    for (size_t i = 0; i < createInfos.size(); i++)
+    {
+        if (i + 1 < createInfos.size())
+            createInfos[i].nextStage = createInfos[i + 1].stage;
+        if (createInfos.size() > 1)
+            createInfos[i].flags = VK_SHADER_CREATE_LINK_STAGE_BIT_EXT;
+    }
+
+    m_ShaderObjects.resize(createInfos.size());
+    vkr = (*m_Context)->GetShaderObjectDispatch().CreateShaders(device, (uint32_t)createInfos.size(), createInfos.data(), nullptr, m_ShaderObjects.data());
+    assert(vkr == VK_SUCCESS);
+
+    for (auto blob : blobs)
+        delete[] blob;
+}
+
+void SampleRender::VKShader::StageShaderObjects(VkCommandBuffer commandBuffer)
+{
+    //the same descriptions the pipeline path bakes, applied as dynamic state
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+    VkPipelineViewportStateCreateInfo viewportState{};
+    VkPipelineMultisampleStateCreateInfo multisampling{};
+    VkPipelineRasterizationStateCreateInfo rasterizer{};
+    VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+    VkPipelineColorBlendStateCreateInfo colorBlending{};
+    VkPipelineDepthStencilStateCreateInfo depthStencil{};
+
+    SetInputAssemblyViewportAndMultisampling(&inputAssembly, &viewportState, &multisampling);
+    SetRasterizer(&rasterizer);
+    SetBlend(&colorBlendAttachment, &colorBlending);
+    SetDepthStencil(&depthStencil);
+
+    const ShaderObjectDispatch& dispatch = (*m_Context)->GetShaderObjectDispatch();
+    dispatch.CmdBindShaders(commandBuffer, (uint32_t)m_ShaderObjects.size(), m_ShaderObjectStages.data(), m_ShaderObjects.data());
+
+    vkCmdSetPrimitiveTopology(commandBuffer, inputAssembly.topology);
+    vkCmdSetPrimitiveRestartEnable(commandBuffer, inputAssembly.primitiveRestartEnable);
+    dispatch.CmdSetVertexInput(commandBuffer, (uint32_t)m_VertexBindings.size(), m_VertexBindings.data(), (uint32_t)m_VertexAttributes.size(), m_VertexAttributes.data());
+
+    vkCmdSetRasterizerDiscardEnable(commandBuffer, rasterizer.rasterizerDiscardEnable);
+    dispatch.CmdSetPolygonMode(commandBuffer, rasterizer.polygonMode);
+    vkCmdSetCullMode(commandBuffer, rasterizer.cullMode);
+    vkCmdSetFrontFace(commandBuffer, rasterizer.frontFace);
+    vkCmdSetDepthBiasEnable(commandBuffer, rasterizer.depthBiasEnable);
+
+    VkSampleMask sampleMask = 0xffffffffu;
+    dispatch.CmdSetRasterizationSamples(commandBuffer, multisampling.rasterizationSamples);
+    dispatch.CmdSetSampleMask(commandBuffer, multisampling.rasterizationSamples, &sampleMask);
+    dispatch.CmdSetAlphaToCoverageEnable(commandBuffer, multisampling.alphaToCoverageEnable);
+
+    VkColorBlendEquationEXT blendEquation{};
+    blendEquation.srcColorBlendFactor = colorBlendAttachment.srcColorBlendFactor;
+    blendEquation.dstColorBlendFactor = colorBlendAttachment.dstColorBlendFactor;
+    blendEquation.colorBlendOp = colorBlendAttachment.colorBlendOp;
+    blendEquation.srcAlphaBlendFactor = colorBlendAttachment.srcAlphaBlendFactor;
+    blendEquation.dstAlphaBlendFactor = colorBlendAttachment.dstAlphaBlendFactor;
+    blendEquation.alphaBlendOp = colorBlendAttachment.alphaBlendOp;
+    dispatch.CmdSetColorBlendEnable(commandBuffer, 0, 1, &colorBlendAttachment.blendEnable);
+    dispatch.CmdSetColorBlendEquation(commandBuffer, 0, 1, &blendEquation);
+    dispatch.CmdSetColorWriteMask(commandBuffer, 0, 1, &colorBlendAttachment.colorWriteMask);
+
+    vkCmdSetDepthTestEnable(commandBuffer, depthStencil.depthTestEnable);
+    vkCmdSetDepthWriteEnable(commandBuffer, depthStencil.depthWriteEnable);
+    vkCmdSetDepthCompareOp(commandBuffer, depthStencil.depthCompareOp);
+    vkCmdSetDepthBoundsTestEnable(commandBuffer, depthStencil.depthBoundsTestEnable);
+    vkCmdSetStencilTestEnable(commandBuffer, depthStencil.stencilTestEnable);
+}
+
 void SampleRender::VKShader::InitJsonAndPaths(std::string json_controller_path)
 {
     Json::Reader reader;
@@ -932,10 +1322,35 @@ VkFormat SampleRender::VKShader::GetNativeFormat(ShaderDataType type)
     case ShaderDataType::Uint3: return VK_FORMAT_R32G32B32_UINT;
     case ShaderDataType::Uint4: return VK_FORMAT_R32G32B32A32_UINT;
     case ShaderDataType::Bool: return VK_FORMAT_R8_UINT;
+    case ShaderDataType::Half2: return VK_FORMAT_R16G16_SFLOAT;
+    case ShaderDataType::Half4: return VK_FORMAT_R16G16B16A16_SFLOAT;
+    case ShaderDataType::Byte4: return VK_FORMAT_R8G8B8A8_SINT;
+    case ShaderDataType::Byte4Norm: return VK_FORMAT_R8G8B8A8_SNORM;
+    case ShaderDataType::Ubyte4: return VK_FORMAT_R8G8B8A8_UINT;
+    case ShaderDataType::Ubyte4Norm: return VK_FORMAT_R8G8B8A8_UNORM;
+    case ShaderDataType::Short2: return VK_FORMAT_R16G16_SINT;
+    case ShaderDataType::Short2Norm: return VK_FORMAT_R16G16_SNORM;
+    case ShaderDataType::Short4: return VK_FORMAT_R16G16B16A16_SINT;
+    case ShaderDataType::Short4Norm: return VK_FORMAT_R16G16B16A16_SNORM;
+    case ShaderDataType::Ushort2: return VK_FORMAT_R16G16_UINT;
+    case ShaderDataType::Ushort2Norm: return VK_FORMAT_R16G16_UNORM;
+    case ShaderDataType::Ushort4: return VK_FORMAT_R16G16B16A16_UINT;
+    case ShaderDataType::Ushort4Norm: return VK_FORMAT_R16G16B16A16_UNORM;
+    case ShaderDataType::Uint1010102Norm: return VK_FORMAT_A2B10G10R10_UNORM_PACK32;
     default: return VK_FORMAT_UNDEFINED;
     }
 }
 
+VkVertexInputRate SampleRender::VKShader::GetNativeInputRate(InputRate rate)
+{
+    switch (rate)
+    {
+    case InputRate::Instance: return VK_VERTEX_INPUT_RATE_INSTANCE;
+    case InputRate::Vertex:
+    default: return VK_VERTEX_INPUT_RATE_VERTEX;
+    }
+}
+
 VkBufferUsageFlagBits SampleRender::VKShader::GetNativeBufferUsage(BufferType type)
 {
     switch (type)
@@ -953,7 +1368,7 @@ VkDescriptorType SampleRender::VKShader::GetNativeDescriptorType(BufferType type
     switch (type)
     {
     case SampleRender::BufferType::UNIFORM_CONSTANT_BUFFER:
-        return VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        return VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     case SampleRender::BufferType::TEXTURE_BUFFER:
         return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     default:
@@ -5,21 +5,28 @@
 #include "DXCSafeInclude.hpp"
 #include <json/json.h>
 #include <functional>
+#include <future>
+#include <atomic>
+#include "ThreadPool.hpp"
 
 namespace SampleRender
 {
-	//Resource Memomy View
-	struct RM
+	//Uniforms live in the frame allocator and are bound with dynamic offsets
+	struct DynamicUniform
 	{
-		VkBuffer Resource;
-		VkDeviceMemory Memory;
+		//CPU copy, written again when a frame binds the uniform without updating it
+		std::vector<uint8_t> Data;
+		uint32_t Offset;
+		uint64_t Epoch;
 	};
 
 	struct IMGB
 	{
-		VkImage Resource;
-		VkDeviceMemory Memory;
-		VkImageView View;
+		VkImage Resource = VK_NULL_HANDLE;
+		VKAllocation Memory;
+		VkImageView View = VK_NULL_HANDLE;
+		//slot in the bindless heap, UINT32_MAX until registered or when it is disabled
+		uint32_t BindlessIndex = UINT32_MAX;
 	};
 
 	/*struct DescriptorTable
@@ -27,60 +34,86 @@ namespace SampleRender
 		VkDescriptorSet Descriptor;
 	};*/
 
-	class SAMPLE_RENDER_DLL_COMMAND VKShader : public Shader
+	class SAMPLE_RENDER_DLL_COMMAND VKShader : public Shader, public VKRelocatable
 	{
 	public:
-		VKShader(const std::shared_ptr<VKContext>* context, std::string json_controller_path, InputBufferLayout layout, SmallBufferLayout smallBufferLayout, UniformLayout uniformLayout, TextureLayout textureLayout, SamplerLayout samplerLayout);
+		//With a build pool the constructor returns right away and the pipeline is created on a worker
+		VKShader(const std::shared_ptr<VKContext>* context, std::string json_controller_path, InputBufferLayout layout, SmallBufferLayout smallBufferLayout, UniformLayout uniformLayout, TextureLayout textureLayout, SamplerLayout samplerLayout, ThreadPool* buildPool = nullptr);
 		~VKShader();
 
 		void Stage() override;
 		uint32_t GetStride() const override;
 		uint32_t GetOffset() const override;
+		bool IsReady() const override;
 
 		void BindSmallBuffer(const void* data, size_t size, uint32_t bindingSlot) override;
 		void BindUniforms(const void* data, size_t size, uint32_t shaderRegister) override;
 		void BindTexture(uint32_t bindingSlot) override;
+		uint32_t GetTextureIndex(uint32_t shaderRegister) const override;
+		uint32_t GetSamplerIndex(uint32_t shaderRegister) const override;
+
+		//Textures move only while the GPU is idle, frames in flight sample the old image in its read layout
+		bool CanRelocate(bool gpuIdle, uint64_t completedUpload) const override;
+		void Relocate(VkCommandBuffer commandBuffer, const VKAllocation& oldMemory, const VKAllocation& newMemory) override;
+
+		//Builds and drops a pipeline described by a manifest entry, only to populate the pipeline cache
+		static void WarmUpPipeline(VKContext* context, const Json::Value& entry);
 
 	private:
 
-		void PreallocatesDescSets();
+		void Build(std::string json_controller_path);
 
-		void CreateCopyPipeline();
-		QueueFamilyIndices FindQueueFamilies(VkPhysicalDevice adapter);
+		void PreallocatesDescSets();
 
 		bool IsUniformValid(size_t size);
 		void PreallocateUniform(const void* data, UniformElement uniformElement);
 		void MapUniform(const void* data, size_t size, uint32_t shaderRegister);
+		void PushUniform(uint32_t shaderRegister);
 		void BindUniform(uint32_t shaderRegister);
+		//Binds the set with the current offset of every dynamic uniform of the layout, not only the space's
+		void BindDescriptorSet(uint32_t spaceSet);
+		//Frame set of a space with textures, written from the current views through the descriptor cache
+		VkDescriptorSet GetCachedTextureSet(uint32_t spaceSet);
+		bool HasTextures(uint32_t spaceSet);
+		//Persistent sets of the spaces holding only uniforms
 		void CreateDescriptorSets();
-		uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
 
 		void CreateTexture(TextureElement textureElement);
 		void AllocateTexture(TextureElement textureElement);
 		void CopyTextureBuffer(TextureElement textureElement);
+		//Host image copy only pays off when the image memory is also host visible
+		bool UsesHostImageCopy() const;
+		VkImageView CreateTextureView(VkImage image);
+		static VkImageCreateInfo GetTextureImageInfo(TextureElement textureElement, bool hostTransfer);
 
 		void CreateSampler(SamplerElement samplerElement);
+		//The shader's own set, followed by the bindless heap when it is enabled
+		std::vector<VkDescriptorSetLayout> GetSetLayouts() const;
 
 		//Close to RootSignature
-		void CreateDescriptorSetLayout();
-		void CreateDescriptorPool();
+		void CreateDescriptorSetLayout(std::vector<VkDescriptorSetLayoutBinding>* bindings);
 
 		void BindSmallBufferIntern(const void* data, size_t size, uint32_t bindingSlot, size_t offset);
 
 		void PushShader(std::string_view stage, VkPipelineShaderStageCreateInfo* graphicsDesc);
+		//Shader object path, links every stage into VkShaderEXT objects instead of a pipeline
+		void CreateShaderObjects(const VkPushConstantRange& pushConstantRange);
+		void StageShaderObjects(VkCommandBuffer commandBuffer);
 		void InitJsonAndPaths(std::string json_controller_path);
-		void SetRasterizer(VkPipelineRasterizationStateCreateInfo* rasterizer);
-		void SetInputAssemblyViewportAndMultisampling(VkPipelineInputAssemblyStateCreateInfo* inputAssembly, VkPipelineViewportStateCreateInfo* viewportState, VkPipelineMultisampleStateCreateInfo* multisampling);
-		void SetBlend(VkPipelineColorBlendAttachmentState* colorBlendAttachment, VkPipelineColorBlendStateCreateInfo* colorBlending);
-		void SetDepthStencil(VkPipelineDepthStencilStateCreateInfo* depthStencil);
+		static void SetRasterizer(VkPipelineRasterizationStateCreateInfo* rasterizer);
+		static void SetInputAssemblyViewportAndMultisampling(VkPipelineInputAssemblyStateCreateInfo* inputAssembly, VkPipelineViewportStateCreateInfo* viewportState, VkPipelineMultisampleStateCreateInfo* multisampling);
+		static void SetBlend(VkPipelineColorBlendAttachmentState* colorBlendAttachment, VkPipelineColorBlendStateCreateInfo* colorBlending);
+		static void SetDepthStencil(VkPipelineDepthStencilStateCreateInfo* depthStencil);
 
 		static VkFormat GetNativeFormat(ShaderDataType type);
+		static VkVertexInputRate GetNativeInputRate(InputRate rate);
 		static VkBufferUsageFlagBits GetNativeBufferUsage(BufferType type);
 		static VkDescriptorType GetNativeDescriptorType(BufferType type);
 		static VkImageType GetNativeTensor(TextureTensor tensor);
 		static VkImageViewType GetNativeTensorView(TextureTensor tensor);
 
 		static const std::list<std::string> s_GraphicsPipelineStages;
+		static const std::vector<VkDynamicState> s_DynamicStates;
 		static VkFilter GetNativeFilter(SamplerFilter filter);
 		static VkSamplerAddressMode GetNativeAddressMode(AddressMode addressMode);
 
@@ -90,23 +123,24 @@ namespace SampleRender
 		std::unordered_map<std::string, VkShaderModule> m_Modules;
 		std::unordered_map<std::string, std::string> m_ModulesEntrypoint;
 
-		std::unordered_map<uint32_t, RM> m_Uniforms;
+		std::unordered_map<uint32_t, DynamicUniform> m_Uniforms;
 		std::unordered_map<uint32_t, VkSampler> m_Samplers;
+		//bindless heap slot of each sampler, by shader register
+		std::unordered_map<uint32_t, uint32_t> m_SamplerIndices;
 		std::unordered_map<uint32_t, IMGB> m_Textures;
+		//latest upload ticket among the textures
+		uint64_t m_UploadTicket = 0;
+		//only the spaces without textures, the others come from the frame descriptor cache
 		std::unordered_map<uint32_t, VkDescriptorSet> m_DescriptorSets;
 		//std::unordered_map<uint32_t, DescriptorTable> m_UniformsTable;
 		//std::unordered_map<uint32_t, DescriptorTable> m_TexturesTable;
 		
 		//VkDescriptorSet m_DescriptorSet;
 
-		VkCommandPool m_CopyCommandPool;
-		VkCommandBuffer m_CopyCommandBuffer;
-		VkQueue m_CopyQueue;
 
 		Json::Value m_PipelineInfo;
 
-		VkDescriptorSetLayout m_RootSignature;
-		VkDescriptorPool m_DescriptorPool;
+		VkDescriptorSetLayout m_RootSignature = VK_NULL_HANDLE;
 		InputBufferLayout m_Layout;
 		SmallBufferLayout m_SmallBufferLayout;
 		UniformLayout m_UniformLayout;
@@ -114,7 +148,15 @@ namespace SampleRender
 		SamplerLayout m_SamplerLayout;
 		const std::shared_ptr<VKContext>* m_Context;
 		std::string m_ShaderDir;
-		VkPipeline m_GraphicsPipeline;
-		VkPipelineLayout m_PipelineLayout;
+		VkPipeline m_GraphicsPipeline = VK_NULL_HANDLE;
+		VkPipelineLayout m_PipelineLayout = VK_NULL_HANDLE;
+		std::vector<VkShaderStageFlagBits> m_ShaderObjectStages;
+		std::vector<VkShaderEXT> m_ShaderObjects;
+		//vertex input is dynamic state for shader objects
+		std::vector<VkVertexInputBindingDescription2EXT> m_VertexBindings;
+		std::vector<VkVertexInputAttributeDescription2EXT> m_VertexAttributes;
+
+		std::future<void> m_Build;
+		std::atomic<bool> m_Built = false;
 	};
 }
@@ -0,0 +1,492 @@
+#include "VKUploadManager.hpp"
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+const VkDeviceSize SampleRender::VKUploadManager::s_RingAlignment = 16;
+
+SampleRender::VKUploadManager::VKUploadManager(VKContext* context, VkDeviceSize ringSize) :
+    m_Context(context), m_RingSize(ringSize)
+{
+    QueueFamilyIndices indices = m_Context->GetQueueFamilies();
+    m_GraphicsFamily = indices.graphicsFamily.value();
+    m_Async = indices.transferFamily.has_value();
+    if (m_Async)
+    {
+        m_TransferFamily = indices.transferFamily.value();
+        CreateTransferObjects();
+    }
+
+    CreateStagingBuffer(m_RingSize, m_RingBuffer, m_RingMemory);
+    m_RingData = m_RingMemory.MappedData;
+}
+
+SampleRender::VKUploadManager::~VKUploadManager()
+{
+    //the owner idles the device first, so every batch is complete
+    auto device = m_Context->GetDevice();
+    auto allocator = m_Context->GetMemoryAllocator();
+    for (auto& dedicated : m_InFlightDedicated)
+    {
+        vkDestroyBuffer(device, dedicated.second.Buffer, nullptr);
+        allocator->Free(dedicated.second.Memory);
+    }
+    for (auto& dedicated : m_BatchDedicated)
+    {
+        vkDestroyBuffer(device, dedicated.Buffer, nullptr);
+        allocator->Free(dedicated.Memory);
+    }
+
+    vkDestroyBuffer(device, m_RingBuffer, nullptr);
+    allocator->Free(m_RingMemory);
+
+    if (m_Async)
+    {
+        vkDestroyCommandPool(device, m_TransferCommandPool, nullptr);
+        vkDestroySemaphore(device, m_TransferTimeline, nullptr);
+    }
+}
+
+uint64_t SampleRender::VKUploadManager::UploadBuffer(VkBuffer dstBuffer, const void* data, VkDeviceSize size, VkDeviceSize dstOffset)
+{
+    std::lock_guard<std::mutex> lock(m_UploadMutex);
+
+    BufferCopy copy{};
+    copy.Destination = dstBuffer;
+    copy.Region.dstOffset = dstOffset;
+    copy.Region.size = size;
+    copy.Source = Stage(data, size, copy.Region.srcOffset);
+    m_BufferCopies.push_back(copy);
+    return GetNextTicket();
+}
+
+uint64_t SampleRender::VKUploadManager::UploadImage(VkImage dstImage, const void* data, VkDeviceSize size, VkExtent3D extent)
+{
+    std::lock_guard<std::mutex> lock(m_UploadMutex);
+
+    ImageCopy copy{};
+    copy.Destination = dstImage;
+    copy.Region.bufferRowLength = 0;
+    copy.Region.bufferImageHeight = 0;
+    copy.Region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    copy.Region.imageSubresource.mipLevel = 0;
+    copy.Region.imageSubresource.baseArrayLayer = 0;
+    copy.Region.imageSubresource.layerCount = 1;
+    copy.Region.imageOffset = { 0, 0, 0 };
+    copy.Region.imageExtent = extent;
+    copy.Source = Stage(data, size, copy.Region.bufferOffset);
+    m_ImageCopies.push_back(copy);
+    return GetNextTicket();
+}
+
+bool SampleRender::VKUploadManager::IsUploadComplete(uint64_t ticket)
+{
+    //on the graphics queue every copy is flushed ahead of the frame that uses it
+    if (!m_Async)
+        return true;
+    std::lock_guard<std::mutex> lock(m_UploadMutex);
+    return ticket <= m_AcquiredValue;
+}
+
+uint64_t SampleRender::VKUploadManager::GetCompletedTicket()
+{
+    if (!m_Async)
+        return UINT64_MAX;
+    std::lock_guard<std::mutex> lock(m_UploadMutex);
+    return m_AcquiredValue;
+}
+
+uint64_t SampleRender::VKUploadManager::Flush()
+{
+    std::lock_guard<std::mutex> lock(m_UploadMutex);
+    return FlushLocked();
+}
+
+uint64_t SampleRender::VKUploadManager::GetLastSubmittedValue()
+{
+    std::lock_guard<std::mutex> lock(m_UploadMutex);
+    return m_LastSubmittedValue;
+}
+
+void SampleRender::VKUploadManager::WaitUploads(uint64_t value)
+{
+    if (value == 0)
+        return;
+    if (!m_Async)
+    {
+        m_Context->WaitTimelineValue(value);
+        return;
+    }
+
+    VkSemaphoreWaitInfo waitInfo{};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &m_TransferTimeline;
+    waitInfo.pValues = &value;
+    vkWaitSemaphores(m_Context->GetDevice(), &waitInfo, UINT64_MAX);
+}
+
+uint64_t SampleRender::VKUploadManager::RecordAcquireBarriers(VkCommandBuffer commandBuffer)
+{
+    if (!m_Async)
+        return 0;
+
+    std::lock_guard<std::mutex> lock(m_UploadMutex);
+    uint64_t completedValue = GetCompletedValue();
+    std::vector<VkBufferMemoryBarrier> bufferBarriers;
+    std::vector<VkImageMemoryBarrier> imageBarriers;
+    uint64_t acquiredValue = 0;
+    //only finished batches are taken, the frame never stalls on a copy still in flight
+    while (!m_PendingAcquires.empty() && (m_PendingAcquires.front().Value <= completedValue))
+    {
+        auto& batch = m_PendingAcquires.front();
+        bufferBarriers.insert(bufferBarriers.end(), batch.BufferBarriers.begin(), batch.BufferBarriers.end());
+        imageBarriers.insert(imageBarriers.end(), batch.ImageBarriers.begin(), batch.ImageBarriers.end());
+        acquiredValue = batch.Value;
+        m_PendingAcquires.pop_front();
+    }
+    if (acquiredValue == 0)
+        return 0;
+
+    VkPipelineStageFlags destinationStage = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, destinationStage,
+        0,
+        0, nullptr,
+        (uint32_t)bufferBarriers.size(), bufferBarriers.data(),
+        (uint32_t)imageBarriers.size(), imageBarriers.data()
+    );
+    m_AcquiredValue = acquiredValue;
+    return acquiredValue;
+}
+
+VkSemaphore SampleRender::VKUploadManager::GetUploadSemaphore() const
+{
+    return m_TransferTimeline;
+}
+
+bool SampleRender::VKUploadManager::IsAsync() const
+{
+    return m_Async;
+}
+
+void SampleRender::VKUploadManager::CreateStagingBuffer(VkDeviceSize size, VkBuffer& buffer, VKAllocation& memory)
+{
+    VkResult vkr;
+    auto device = m_Context->GetDevice();
+
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    vkr = vkCreateBuffer(device, &bufferInfo, nullptr, &buffer);
+    assert(vkr == VK_SUCCESS);
+
+    memory = m_Context->GetMemoryAllocator()->AllocateBuffer(buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+}
+
+VkBuffer SampleRender::VKUploadManager::Stage(const void* data, VkDeviceSize size, VkDeviceSize& offset)
+{
+    if (size > m_RingSize)
+    {
+        DedicatedStaging dedicated;
+        CreateStagingBuffer(size, dedicated.Buffer, dedicated.Memory);
+        memcpy(dedicated.Memory.MappedData, data, (size_t)size);
+
+        m_BatchDedicated.push_back(dedicated);
+        offset = 0;
+        return dedicated.Buffer;
+    }
+
+    while (!AllocateRing(size, offset))
+    {
+        //the ring is full, push what is recorded so far and wait for the oldest batch to retire
+        if (m_BatchBytes > 0)
+            FlushLocked();
+        WaitUploads(m_InFlightBatches.front().first);
+        ReclaimCompleted();
+    }
+    memcpy(m_RingData + offset, data, (size_t)size);
+    return m_RingBuffer;
+}
+
+bool SampleRender::VKUploadManager::AllocateRing(VkDeviceSize size, VkDeviceSize& offset)
+{
+    ReclaimCompleted();
+    if (m_RingUsed == 0)
+        m_RingHead = 0;
+
+    VkDeviceSize alignedSize = (size + s_RingAlignment - 1) & ~(s_RingAlignment - 1);
+    VkDeviceSize start = m_RingHead;
+    VkDeviceSize padding = 0;
+    //allocations never straddle the end of the ring, the tail is skipped instead
+    if (start + alignedSize > m_RingSize)
+    {
+        padding = m_RingSize - start;
+        start = 0;
+    }
+    if (m_RingUsed + padding + alignedSize > m_RingSize)
+        return false;
+
+    m_RingHead = (start + alignedSize) % m_RingSize;
+    m_RingUsed += padding + alignedSize;
+    m_BatchBytes += padding + alignedSize;
+    offset = start;
+    return true;
+}
+
+uint64_t SampleRender::VKUploadManager::FlushLocked()
+{
+    if (m_BufferCopies.empty() && m_ImageCopies.empty())
+        return m_LastSubmittedValue;
+
+    VkCommandBuffer commandBuffer = m_Async ? BeginTransferCommands() : m_Context->BeginOneShotCommands();
+
+    std::vector<VkImageMemoryBarrier> imageBarriers(m_ImageCopies.size());
+    for (size_t i = 0; i < m_ImageCopies.size(); i++)
+    {
+        VkImageMemoryBarrier& barrier = imageBarriers[i];
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = m_ImageCopies[i].Destination;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    }
+    if (!imageBarriers.empty())
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, (uint32_t)imageBarriers.size(), imageBarriers.data());
+
+    for (auto& copy : m_BufferCopies)
+        vkCmdCopyBuffer(commandBuffer, copy.Source, copy.Destination, 1, &copy.Region);
+    for (auto& copy : m_ImageCopies)
+        vkCmdCopyBufferToImage(commandBuffer, copy.Source, copy.Destination, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy.Region);
+
+    for (auto& barrier : imageBarriers)
+    {
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    }
+
+    AcquireBatch acquireBatch;
+    if (m_Async)
+    {
+        //release half of the ownership transfer, the frame that picks the batch up records the acquire half
+        std::vector<VkBufferMemoryBarrier> bufferBarriers(m_BufferCopies.size());
+        for (size_t i = 0; i < m_BufferCopies.size(); i++)
+        {
+            VkBufferMemoryBarrier& barrier = bufferBarriers[i];
+            barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = 0;
+            barrier.srcQueueFamilyIndex = m_TransferFamily;
+            barrier.dstQueueFamilyIndex = m_GraphicsFamily;
+            barrier.buffer = m_BufferCopies[i].Destination;
+            barrier.offset = m_BufferCopies[i].Region.dstOffset;
+            barrier.size = m_BufferCopies[i].Region.size;
+        }
+        for (auto& barrier : imageBarriers)
+        {
+            barrier.dstAccessMask = 0;
+            barrier.srcQueueFamilyIndex = m_TransferFamily;
+            barrier.dstQueueFamilyIndex = m_GraphicsFamily;
+        }
+
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+            0,
+            0, nullptr,
+            (uint32_t)bufferBarriers.size(), bufferBarriers.data(),
+            (uint32_t)imageBarriers.size(), imageBarriers.data()
+        );
+
+        for (auto& barrier : bufferBarriers)
+        {
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+        }
+        for (auto& barrier : imageBarriers)
+        {
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        }
+        acquireBatch.BufferBarriers = std::move(bufferBarriers);
+        acquireBatch.ImageBarriers = std::move(imageBarriers);
+    }
+    else
+    {
+        //buffer writes become visible to the indirect, vertex input and shader stages of every later submit
+        VkMemoryBarrier memoryBarrier{};
+        memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        memoryBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+        VkPipelineStageFlags destinationStage = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, destinationStage,
+            0,
+            m_BufferCopies.empty() ? 0 : 1, &memoryBarrier,
+            0, nullptr,
+            (uint32_t)imageBarriers.size(), imageBarriers.data()
+        );
+    }
+
+    m_LastSubmittedValue = m_Async ? SubmitTransferCommands(commandBuffer) : m_Context->SubmitOneShotCommands(commandBuffer);
+
+    if (m_Async)
+    {
+        acquireBatch.Value = m_LastSubmittedValue;
+        m_PendingAcquires.push_back(std::move(acquireBatch));
+    }
+    if (m_BatchBytes > 0)
+        m_InFlightBatches.push_back(std::make_pair(m_LastSubmittedValue, m_BatchBytes));
+    for (auto& dedicated : m_BatchDedicated)
+        m_InFlightDedicated.push_back(std::make_pair(m_LastSubmittedValue, dedicated));
+
+    m_BatchBytes = 0;
+    m_BatchDedicated.clear();
+    m_BufferCopies.clear();
+    m_ImageCopies.clear();
+    return m_LastSubmittedValue;
+}
+
+void SampleRender::VKUploadManager::ReclaimCompleted()
+{
+    if (m_InFlightBatches.empty() && m_InFlightDedicated.empty())
+        return;
+
+    auto device = m_Context->GetDevice();
+    uint64_t completedValue = GetCompletedValue();
+    while (!m_InFlightBatches.empty() && (m_InFlightBatches.front().first <= completedValue))
+    {
+        m_RingUsed -= m_InFlightBatches.front().second;
+        m_InFlightBatches.pop_front();
+    }
+    while (!m_InFlightDedicated.empty() && (m_InFlightDedicated.front().first <= completedValue))
+    {
+        vkDestroyBuffer(device, m_InFlightDedicated.front().second.Buffer, nullptr);
+        m_Context->GetMemoryAllocator()->Free(m_InFlightDedicated.front().second.Memory);
+        m_InFlightDedicated.pop_front();
+    }
+}
+
+uint64_t SampleRender::VKUploadManager::GetNextTicket() const
+{
+    //the transfer timeline is only signaled by this class, one value per flush
+    return m_Async ? (m_TransferValue + 1) : 0;
+}
+
+void SampleRender::VKUploadManager::CreateTransferObjects()
+{
+    VkResult vkr;
+    auto device = m_Context->GetDevice();
+    m_TransferQueue = m_Context->GetTransferQueue();
+
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolInfo.queueFamilyIndex = m_TransferFamily;
+
+    vkr = vkCreateCommandPool(device, &poolInfo, nullptr, &m_TransferCommandPool);
+    assert(vkr == VK_SUCCESS);
+
+    VkSemaphoreTypeCreateInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    timelineInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &timelineInfo;
+
+    vkr = vkCreateSemaphore(device, &semaphoreInfo, nullptr, &m_TransferTimeline);
+    assert(vkr == VK_SUCCESS);
+}
+
+VkCommandBuffer SampleRender::VKUploadManager::BeginTransferCommands()
+{
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    uint64_t completedValue = GetCompletedValue();
+    while (!m_PendingTransferBuffers.empty() && (m_PendingTransferBuffers.front().first <= completedValue))
+    {
+        m_FreeTransferBuffers.push_back(m_PendingTransferBuffers.front().second);
+        m_PendingTransferBuffers.pop_front();
+    }
+
+    if (m_FreeTransferBuffers.empty())
+    {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = m_TransferCommandPool;
+        allocInfo.commandBufferCount = 1;
+
+        VkResult vkr = vkAllocateCommandBuffers(m_Context->GetDevice(), &allocInfo, &commandBuffer);
+        assert(vkr == VK_SUCCESS);
+    }
+    else
+    {
+        commandBuffer = m_FreeTransferBuffers.back();
+        m_FreeTransferBuffers.pop_back();
+    }
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin transfer command buffer!");
+    }
+    return commandBuffer;
+}
+
+uint64_t SampleRender::VKUploadManager::SubmitTransferCommands(VkCommandBuffer commandBuffer)
+{
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record transfer command buffer!");
+    }
+
+    uint64_t value = ++m_TransferValue;
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.signalSemaphoreValueCount = 1;
+    timelineInfo.pSignalSemaphoreValues = &value;
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &m_TransferTimeline;
+
+    if (vkQueueSubmit(m_TransferQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit transfer command buffer!");
+    }
+    m_PendingTransferBuffers.push_back(std::make_pair(value, commandBuffer));
+    return value;
+}
+
+uint64_t SampleRender::VKUploadManager::GetCompletedValue() const
+{
+    if (!m_Async)
+        return m_Context->GetCompletedTimelineValue();
+
+    uint64_t value = 0;
+    vkGetSemaphoreCounterValue(m_Context->GetDevice(), m_TransferTimeline, &value);
+    return value;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "VKContext.hpp"
+#include <vector>
+#include <deque>
+#include <mutex>
+
+namespace SampleRender
+{
+	class SAMPLE_RENDER_DLL_COMMAND VKUploadManager
+	{
+	public:
+		VKUploadManager(VKContext* context, VkDeviceSize ringSize);
+		~VKUploadManager();
+
+		//The data is copied into the staging ring right away, the GPU copy is recorded on the next flush
+		//Both return a ticket to poll with IsUploadComplete
+		uint64_t UploadBuffer(VkBuffer dstBuffer, const void* data, VkDeviceSize size, VkDeviceSize dstOffset = 0);
+		//Transitions from undefined and leaves the image in SHADER_READ_ONLY_OPTIMAL
+		uint64_t UploadImage(VkImage dstImage, const void* data, VkDeviceSize size, VkExtent3D extent);
+
+		//True once the resource can be used by the frame being recorded
+		bool IsUploadComplete(uint64_t ticket);
+		//Every ticket up to the returned one is complete, lets callers holding other locks test tickets without taking the upload lock
+		uint64_t GetCompletedTicket();
+
+		//Records every queued copy and barrier into one command buffer and submits it, returns its value on the upload timeline
+		uint64_t Flush();
+		uint64_t GetLastSubmittedValue();
+		void WaitUploads(uint64_t value);
+
+		//Async path only, hands finished batches over to the graphics family inside the frame command buffer
+		//Returns the upload timeline value the frame submit has to wait on, 0 when nothing was acquired
+		uint64_t RecordAcquireBarriers(VkCommandBuffer commandBuffer);
+		VkSemaphore GetUploadSemaphore() const;
+		//Copies run on a transfer-only queue and are handed to the graphics family through ownership transfers
+		bool IsAsync() const;
+
+	private:
+		struct BufferCopy
+		{
+			VkBuffer Source;
+			VkBuffer Destination;
+			VkBufferCopy Region;
+		};
+
+		struct ImageCopy
+		{
+			VkBuffer Source;
+			VkImage Destination;
+			VkBufferImageCopy Region;
+		};
+
+		struct DedicatedStaging
+		{
+			VkBuffer Buffer;
+			VKAllocation Memory;
+		};
+
+		struct AcquireBatch
+		{
+			uint64_t Value;
+			std::vector<VkBufferMemoryBarrier> BufferBarriers;
+			std::vector<VkImageMemoryBarrier> ImageBarriers;
+		};
+
+		void CreateStagingBuffer(VkDeviceSize size, VkBuffer& buffer, VKAllocation& memory);
+		//Returns the staging buffer and the offset the data was written to
+		VkBuffer Stage(const void* data, VkDeviceSize size, VkDeviceSize& offset);
+		bool AllocateRing(VkDeviceSize size, VkDeviceSize& offset);
+		uint64_t FlushLocked();
+		void ReclaimCompleted();
+		uint64_t GetNextTicket() const;
+
+		//Transfer queue, the graphics path goes through the context one-shot buffers instead
+		void CreateTransferObjects();
+		VkCommandBuffer BeginTransferCommands();
+		uint64_t SubmitTransferCommands(VkCommandBuffer commandBuffer);
+		uint64_t GetCompletedValue() const;
+
+		static const VkDeviceSize s_RingAlignment;
+
+		VKContext* m_Context;
+		std::mutex m_UploadMutex;
+
+		VkBuffer m_RingBuffer;
+		VKAllocation m_RingMemory;
+		uint8_t* m_RingData;
+		VkDeviceSize m_RingSize;
+		VkDeviceSize m_RingHead = 0;
+		VkDeviceSize m_RingUsed = 0;
+		VkDeviceSize m_BatchBytes = 0;
+
+		std::vector<BufferCopy> m_BufferCopies;
+		std::vector<ImageCopy> m_ImageCopies;
+		//uploads bigger than the ring get their own staging buffer, released with the batch
+		std::vector<DedicatedStaging> m_BatchDedicated;
+
+		uint64_t m_LastSubmittedValue = 0;
+		std::deque<std::pair<uint64_t, VkDeviceSize>> m_InFlightBatches;
+		std::deque<std::pair<uint64_t, DedicatedStaging>> m_InFlightDedicated;
+
+		bool m_Async = false;
+		uint32_t m_GraphicsFamily;
+		uint32_t m_TransferFamily;
+		VkQueue m_TransferQueue = VK_NULL_HANDLE;
+		VkCommandPool m_TransferCommandPool = VK_NULL_HANDLE;
+		std::vector<VkCommandBuffer> m_FreeTransferBuffers;
+		std::deque<std::pair<uint64_t, VkCommandBuffer>> m_PendingTransferBuffers;
+		VkSemaphore m_TransferTimeline = VK_NULL_HANDLE;
+		uint64_t m_TransferValue = 0;
+		//released on the transfer queue, waiting to be acquired by a frame
+		std::deque<AcquireBatch> m_PendingAcquires;
+		uint64_t m_AcquiredValue = 0;
+	};
+}
@@ -1,4 +1,5 @@
 #include "InputBufferLayout.hpp"
+#include <algorithm>
 
 uint32_t SampleRender::ShaderDataTypeSize(ShaderDataType type)
 {
@@ -14,6 +15,21 @@ uint32_t SampleRender::ShaderDataTypeSize(ShaderDataType type)
 	case ShaderDataType::Uint3:     return 4 * 3;
 	case ShaderDataType::Uint4:     return 4 * 4;
 	case ShaderDataType::Bool:     return 1;
+	case ShaderDataType::Half2: return 2 * 2;
+	case ShaderDataType::Half4: return 2 * 4;
+	case ShaderDataType::Byte4: return 4;
+	case ShaderDataType::Byte4Norm: return 4;
+	case ShaderDataType::Ubyte4: return 4;
+	case ShaderDataType::Ubyte4Norm: return 4;
+	case ShaderDataType::Short2: return 2 * 2;
+	case ShaderDataType::Short2Norm: return 2 * 2;
+	case ShaderDataType::Short4: return 2 * 4;
+	case ShaderDataType::Short4Norm: return 2 * 4;
+	case ShaderDataType::Ushort2: return 2 * 2;
+	case ShaderDataType::Ushort2Norm: return 2 * 2;
+	case ShaderDataType::Ushort4: return 2 * 4;
+	case ShaderDataType::Ushort4Norm: return 2 * 4;
+	case ShaderDataType::Uint1010102Norm: return 4;
 	}
 
 	Console::CoreError("Unknown ShaderDataType!");
@@ -28,10 +44,12 @@ SampleRender::InputBufferElement::InputBufferElement()
 	m_Size = 0;
 	m_Offset = 0;
 	m_Normalized = false;
+	m_BufferSlot = 0;
+	m_Rate = InputRate::Vertex;
 }
 
-SampleRender::InputBufferElement::InputBufferElement(ShaderDataType type, const std::string& name, bool normalized) :
-	m_Name(name), m_Type(type), m_Size(ShaderDataTypeSize(type)), m_Offset(0), m_Normalized(normalized)
+SampleRender::InputBufferElement::InputBufferElement(ShaderDataType type, const std::string& name, bool normalized, uint32_t bufferSlot, InputRate rate) :
+	m_Name(name), m_Type(type), m_Size(ShaderDataTypeSize(type)), m_Offset(0), m_Normalized(normalized), m_BufferSlot(bufferSlot), m_Rate(rate)
 {
 }
 
@@ -49,6 +67,21 @@ uint32_t SampleRender::InputBufferElement::GetComponentCount() const
 	case ShaderDataType::Uint3:    return 3;
 	case ShaderDataType::Uint4:    return 4;
 	case ShaderDataType::Bool:    return 1;
+	case ShaderDataType::Half2: return 2;
+	case ShaderDataType::Half4: return 4;
+	case ShaderDataType::Byte4: return 4;
+	case ShaderDataType::Byte4Norm: return 4;
+	case ShaderDataType::Ubyte4: return 4;
+	case ShaderDataType::Ubyte4Norm: return 4;
+	case ShaderDataType::Short2: return 2;
+	case ShaderDataType::Short2Norm: return 2;
+	case ShaderDataType::Short4: return 4;
+	case ShaderDataType::Short4Norm: return 4;
+	case ShaderDataType::Ushort2: return 2;
+	case ShaderDataType::Ushort2Norm: return 2;
+	case ShaderDataType::Ushort4: return 4;
+	case ShaderDataType::Ushort4Norm: return 4;
+	case ShaderDataType::Uint1010102Norm: return 4;
 	}
 
 	Console::CoreError("Unknown ShaderDataType!");
@@ -81,6 +114,16 @@ const bool SampleRender::InputBufferElement::IsNormalized() const
 	return m_Normalized;
 }
 
+const uint32_t SampleRender::InputBufferElement::GetBufferSlot() const
+{
+	return m_BufferSlot;
+}
+
+const SampleRender::InputRate SampleRender::InputBufferElement::GetInputRate() const
+{
+	return m_Rate;
+}
+
 SampleRender::InputBufferLayout::InputBufferLayout(const std::initializer_list<InputBufferElement>& elements) :
 	m_Elements(elements)
 {
@@ -93,14 +136,33 @@ SampleRender::InputBufferLayout::InputBufferLayout(const std::vector<InputBuffer
 	CalculateOffsetsAndStride();
 }
 
+uint32_t SampleRender::InputBufferLayout::GetStride(uint32_t bufferSlot) const
+{
+	for (auto& slot : m_Slots)
+		if (slot.Slot == bufferSlot)
+			return slot.Stride;
+	return 0;
+}
+
 void SampleRender::InputBufferLayout::CalculateOffsetsAndStride()
 {
-	uint32_t offset = 0;
-	m_Stride = 0;
+	m_Slots.clear();
 	for (auto& element : m_Elements)
 	{
-		element.m_Offset = offset;
-		offset += element.m_Size;
-		m_Stride += element.m_Size;
+		auto slot = std::find_if(m_Slots.begin(), m_Slots.end(), [&element](const InputBufferSlot& s) { return s.Slot == element.m_BufferSlot; });
+		if (slot == m_Slots.end())
+		{
+			m_Slots.push_back({ element.m_BufferSlot, 0, element.m_Rate });
+			slot = m_Slots.end() - 1;
+		}
+		else if (slot->Rate != element.m_Rate)
+		{
+			Console::CoreError("Input element {} does not match the rate of slot {}", element.m_Name, element.m_BufferSlot);
+			assert(false);
+		}
+		element.m_Offset = slot->Stride;
+		slot->Stride += element.m_Size;
 	}
+	std::sort(m_Slots.begin(), m_Slots.end(), [](const InputBufferSlot& a, const InputBufferSlot& b) { return a.Slot < b.Slot; });
+	m_Stride = GetStride(0);
 }
@@ -4,16 +4,25 @@
 #include <cstdint>
 #include <cassert>
 #include <string>
+#include <vector>
 #include "Console.hpp"
 
 namespace SampleRender
 {
 	enum class SAMPLE_SHADER_MNG_DLL_COMMAND ShaderDataType
 	{
-		None = 0, Float, Float2, Float3, Float4, Mat4, Uint, Uint2, Uint3, Uint4, Bool
+		None = 0, Float, Float2, Float3, Float4, Mat4, Uint, Uint2, Uint3, Uint4, Bool,
+		//Packed formats, Norm types are read as floats in [0, 1] or [-1, 1]
+		Half2, Half4, Byte4, Byte4Norm, Ubyte4, Ubyte4Norm, Short2, Short2Norm, Short4, Short4Norm,
+		Ushort2, Ushort2Norm, Ushort4, Ushort4Norm, Uint1010102Norm
 	};
 
 	SAMPLE_SHADER_MNG_DLL_COMMAND uint32_t ShaderDataTypeSize(ShaderDataType type);
+
+	enum class SAMPLE_SHADER_MNG_DLL_COMMAND InputRate
+	{
+		Vertex = 0, Instance
+	};
 	
 
 	class SAMPLE_SHADER_MNG_DLL_COMMAND InputBufferElement
@@ -23,7 +32,8 @@ namespace SampleRender
 	public:
 		InputBufferElement();
 
-		InputBufferElement(ShaderDataType type, const std::string& name, bool normalized = false);
+		//Elements sharing a buffer slot are packed in declaration order and must share the rate
+		InputBufferElement(ShaderDataType type, const std::string& name, bool normalized = false, uint32_t bufferSlot = 0, InputRate rate = InputRate::Vertex);
 
 		uint32_t GetComponentCount() const;
 
@@ -32,12 +42,24 @@ namespace SampleRender
 		const uint32_t GetSize() const;
 		const uint32_t GetOffset() const;
 		const bool IsNormalized() const;
+		const uint32_t GetBufferSlot() const;
+		const InputRate GetInputRate() const;
 	private:
 		std::string m_Name;
 		ShaderDataType m_Type;
 		uint32_t m_Size;
 		uint32_t m_Offset;
 		bool m_Normalized;
+		uint32_t m_BufferSlot;
+		InputRate m_Rate;
+	};
+
+	//One vertex buffer binding, sorted by slot in the layout
+	struct SAMPLE_SHADER_MNG_DLL_COMMAND InputBufferSlot
+	{
+		uint32_t Slot;
+		uint32_t Stride;
+		InputRate Rate;
 	};
 
 	class SAMPLE_SHADER_MNG_DLL_COMMAND InputBufferLayout
@@ -48,8 +70,11 @@ namespace SampleRender
 		InputBufferLayout(const std::initializer_list<InputBufferElement>& elements);
 		InputBufferLayout(const std::vector<InputBufferElement>& elements);
 
+		//Stride of slot 0
 		inline uint32_t GetStride() const { return m_Stride; }
+		uint32_t GetStride(uint32_t bufferSlot) const;
 		inline const std::vector<InputBufferElement>& GetElements() const { return m_Elements; }
+		inline const std::vector<InputBufferSlot>& GetBufferSlots() const { return m_Slots; }
 
 		std::vector<InputBufferElement>::iterator begin() { return m_Elements.begin(); }
 		std::vector<InputBufferElement>::iterator end() { return m_Elements.end(); }
@@ -60,6 +85,7 @@ namespace SampleRender
 		
 	private:
 		std::vector<InputBufferElement> m_Elements;
+		std::vector<InputBufferSlot> m_Slots;
 		uint32_t m_Stride = 0;
 	};
 }
\ No newline at end of file
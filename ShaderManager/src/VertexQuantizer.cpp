@@ -0,0 +1,166 @@
+#include "VertexQuantizer.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+std::vector<uint8_t> SampleRender::VertexQuantizer::Pack(const InputBufferLayout& layout, const float* vertices, size_t vertexCount, uint32_t bufferSlot)
+{
+	uint32_t stride = layout.GetStride(bufferSlot);
+	std::vector<uint8_t> packed(vertexCount * stride);
+
+	const float* input = vertices;
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		uint8_t* vertex = packed.data() + i * stride;
+		for (const auto& element : layout)
+		{
+			if (element.GetBufferSlot() != bufferSlot)
+				continue;
+			PackElement(element.GetType(), input, vertex + element.GetOffset());
+			input += element.GetComponentCount();
+		}
+	}
+	return packed;
+}
+
+void SampleRender::VertexQuantizer::PackElement(ShaderDataType type, const float* components, void* output)
+{
+	switch (type)
+	{
+	case ShaderDataType::Float:
+	case ShaderDataType::Float2:
+	case ShaderDataType::Float3:
+	case ShaderDataType::Float4:
+	case ShaderDataType::Mat4:
+	{
+		memcpy(output, components, ShaderDataTypeSize(type));
+		break;
+	}
+	case ShaderDataType::Uint:
+	case ShaderDataType::Uint2:
+	case ShaderDataType::Uint3:
+	case ShaderDataType::Uint4:
+	{
+		uint32_t* values = (uint32_t*)output;
+		for (uint32_t i = 0; i < ShaderDataTypeSize(type) / 4; i++)
+			values[i] = (uint32_t)components[i];
+		break;
+	}
+	case ShaderDataType::Bool:
+	{
+		*(uint8_t*)output = components[0] != 0.0f ? 1 : 0;
+		break;
+	}
+	case ShaderDataType::Half2:
+	case ShaderDataType::Half4:
+	{
+		uint16_t* values = (uint16_t*)output;
+		for (uint32_t i = 0; i < ShaderDataTypeSize(type) / 2; i++)
+			values[i] = FloatToHalf(components[i]);
+		break;
+	}
+	case ShaderDataType::Byte4:
+	case ShaderDataType::Byte4Norm:
+	{
+		int8_t* values = (int8_t*)output;
+		for (uint32_t i = 0; i < 4; i++)
+			values[i] = (type == ShaderDataType::Byte4Norm) ? (int8_t)ToSnorm(components[i], 8) : (int8_t)std::clamp(components[i], -128.0f, 127.0f);
+		break;
+	}
+	case ShaderDataType::Ubyte4:
+	case ShaderDataType::Ubyte4Norm:
+	{
+		uint8_t* values = (uint8_t*)output;
+		for (uint32_t i = 0; i < 4; i++)
+			values[i] = (type == ShaderDataType::Ubyte4Norm) ? (uint8_t)ToUnorm(components[i], 8) : (uint8_t)std::clamp(components[i], 0.0f, 255.0f);
+		break;
+	}
+	case ShaderDataType::Short2:
+	case ShaderDataType::Short2Norm:
+	case ShaderDataType::Short4:
+	case ShaderDataType::Short4Norm:
+	{
+		bool normalized = (type == ShaderDataType::Short2Norm) || (type == ShaderDataType::Short4Norm);
+		int16_t* values = (int16_t*)output;
+		for (uint32_t i = 0; i < ShaderDataTypeSize(type) / 2; i++)
+			values[i] = normalized ? (int16_t)ToSnorm(components[i], 16) : (int16_t)std::clamp(components[i], -32768.0f, 32767.0f);
+		break;
+	}
+	case ShaderDataType::Ushort2:
+	case ShaderDataType::Ushort2Norm:
+	case ShaderDataType::Ushort4:
+	case ShaderDataType::Ushort4Norm:
+	{
+		bool normalized = (type == ShaderDataType::Ushort2Norm) || (type == ShaderDataType::Ushort4Norm);
+		uint16_t* values = (uint16_t*)output;
+		for (uint32_t i = 0; i < ShaderDataTypeSize(type) / 2; i++)
+			values[i] = normalized ? (uint16_t)ToUnorm(components[i], 16) : (uint16_t)std::clamp(components[i], 0.0f, 65535.0f);
+		break;
+	}
+	case ShaderDataType::Uint1010102Norm:
+	{
+		//red in the low bits, matching both A2B10G10R10_UNORM_PACK32 and R10G10B10A2_UNORM
+		uint32_t value = ToUnorm(components[0], 10) | (ToUnorm(components[1], 10) << 10) | (ToUnorm(components[2], 10) << 20) | (ToUnorm(components[3], 2) << 30);
+		memcpy(output, &value, sizeof(uint32_t));
+		break;
+	}
+	default:
+	{
+		Console::CoreError("Unknown ShaderDataType!");
+		assert(false);
+		break;
+	}
+	}
+}
+
+uint16_t SampleRender::VertexQuantizer::FloatToHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(float));
+
+	uint32_t sign = (bits >> 16) & 0x8000;
+	uint32_t floatExponent = (bits >> 23) & 0xff;
+	uint32_t mantissa = bits & 0x7fffff;
+
+	//infinity and NaN, NaN keeps a mantissa bit set
+	if (floatExponent == 0xff)
+		return (uint16_t)(sign | 0x7c00 | (mantissa != 0 ? 0x200 : 0));
+
+	int32_t exponent = (int32_t)floatExponent - 127 + 15;
+	if (exponent >= 0x1f)
+		return (uint16_t)(sign | 0x7c00);
+
+	if (exponent <= 0)
+	{
+		if (exponent < -10)
+			return (uint16_t)sign;
+		//subnormal half, the implicit bit is shifted into the mantissa
+		mantissa |= 0x800000;
+		uint32_t shift = (uint32_t)(14 - exponent);
+		uint32_t half = mantissa >> shift;
+		uint32_t rest = mantissa & ((1u << shift) - 1);
+		uint32_t halfway = 1u << (shift - 1);
+		if ((rest > halfway) || ((rest == halfway) && (half & 1)))
+			half++;
+		return (uint16_t)(sign | half);
+	}
+
+	uint32_t half = ((uint32_t)exponent << 10) | (mantissa >> 13);
+	uint32_t rest = mantissa & 0x1fff;
+	//a carry out of the mantissa correctly bumps the exponent
+	if ((rest > 0x1000) || ((rest == 0x1000) && (half & 1)))
+		half++;
+	return (uint16_t)(sign | half);
+}
+
+uint32_t SampleRender::VertexQuantizer::ToUnorm(float value, uint32_t bits)
+{
+	float maxValue = (float)((1u << bits) - 1);
+	return (uint32_t)std::lround(std::clamp(value, 0.0f, 1.0f) * maxValue);
+}
+
+int32_t SampleRender::VertexQuantizer::ToSnorm(float value, uint32_t bits)
+{
+	float maxValue = (float)((1u << (bits - 1)) - 1);
+	return (int32_t)std::lround(std::clamp(value, -1.0f, 1.0f) * maxValue);
+}
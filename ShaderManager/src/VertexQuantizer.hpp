@@ -0,0 +1,26 @@
+#pragma once
+
+#include "ShaderManagerDLLMacro.hpp"
+#include "InputBufferLayout.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace SampleRender
+{
+	class SAMPLE_SHADER_MNG_DLL_COMMAND VertexQuantizer
+	{
+	public:
+		//vertices holds, per vertex, the components of every element of the slot as floats, in declaration order
+		//Returns vertexCount * stride bytes laid out as the slot describes
+		static std::vector<uint8_t> Pack(const InputBufferLayout& layout, const float* vertices, size_t vertexCount, uint32_t bufferSlot = 0);
+		//Writes GetComponentCount() floats as one element of the given type
+		static void PackElement(ShaderDataType type, const float* components, void* output);
+
+		//Rounds to nearest even, out of range values become infinity
+		static uint16_t FloatToHalf(float value);
+
+	private:
+		static uint32_t ToUnorm(float value, uint32_t bits);
+		static int32_t ToSnorm(float value, uint32_t bits);
+	};
+}
@@ -0,0 +1,56 @@
+#include "ThreadPool.hpp"
+#include <algorithm>
+
+SampleRender::ThreadPool::ThreadPool(uint32_t threads)
+{
+	if (threads == 0)
+		threads = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+	for (uint32_t i = 0; i < threads; i++)
+		m_Threads.emplace_back(&ThreadPool::WorkerLoop, this);
+}
+
+SampleRender::ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_TasksMutex);
+		m_Stopping = true;
+	}
+	m_TasksCondition.notify_all();
+	for (auto& thread : m_Threads)
+		thread.join();
+}
+
+std::future<void> SampleRender::ThreadPool::Enqueue(std::function<void()> task)
+{
+	std::packaged_task<void()> packagedTask(task);
+	std::future<void> result = packagedTask.get_future();
+	{
+		std::lock_guard<std::mutex> lock(m_TasksMutex);
+		m_Tasks.push(std::move(packagedTask));
+	}
+	m_TasksCondition.notify_one();
+	return result;
+}
+
+uint32_t SampleRender::ThreadPool::GetThreadCount() const
+{
+	return (uint32_t)m_Threads.size();
+}
+
+void SampleRender::ThreadPool::WorkerLoop()
+{
+	while (true)
+	{
+		std::packaged_task<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(m_TasksMutex);
+			m_TasksCondition.wait(lock, [this]() { return m_Stopping || !m_Tasks.empty(); });
+			//pending tasks are drained before the workers leave
+			if (m_Tasks.empty())
+				return;
+			task = std::move(m_Tasks.front());
+			m_Tasks.pop();
+		}
+		task();
+	}
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include "UtilsDLLMacro.hpp"
+#include <cstdint>
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+
+namespace SampleRender
+{
+	class SAMPLE_UTILS_DLL_COMMAND ThreadPool
+	{
+	public:
+		//0 uses every hardware thread except the calling one
+		ThreadPool(uint32_t threads = 0);
+		~ThreadPool();
+
+		std::future<void> Enqueue(std::function<void()> task);
+		uint32_t GetThreadCount() const;
+
+	private:
+		void WorkerLoop();
+
+		std::vector<std::thread> m_Threads;
+		std::queue<std::packaged_task<void()>> m_Tasks;
+		std::mutex m_TasksMutex;
+		std::condition_variable m_TasksCondition;
+		bool m_Stopping = false;
+	};
+}